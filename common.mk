@@ -6,6 +6,7 @@ SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/action_macro.c \
 	$(COMMON_DIR)/action_layer.c \
 	$(COMMON_DIR)/action_util.c \
+	$(COMMON_DIR)/report.c \
 	$(COMMON_DIR)/keymap.c \
 	$(COMMON_DIR)/print.c \
 	$(COMMON_DIR)/debug.c \
@@ -29,6 +30,16 @@ ifdef MOUSEKEY_ENABLE
     OPT_DEFS += -DMOUSE_ENABLE
 endif
 
+ifdef TRACE_ENABLE
+    SRC += $(COMMON_DIR)/trace.c
+    OPT_DEFS += -DTRACE_ENABLE
+endif
+
+ifdef MACRO_RECORD_ENABLE
+    SRC += $(COMMON_DIR)/action_macro_record.c
+    OPT_DEFS += -DMACRO_RECORD_ENABLE
+endif
+
 ifdef EXTRAKEY_ENABLE
     OPT_DEFS += -DEXTRAKEY_ENABLE
 endif
@@ -49,6 +60,14 @@ ifdef NKRO_ENABLE
     OPT_DEFS += -DNKRO_ENABLE
 endif
 
+ifdef MOUSE_EXTENDED_REPORT_ENABLE
+    OPT_DEFS += -DMOUSE_EXTENDED_REPORT
+endif
+
+ifdef MOUSE_WHEEL_HIRES_ENABLE
+    OPT_DEFS += -DMOUSE_WHEEL_HIRES
+endif
+
 ifdef USB_6KRO_ENABLE
     OPT_DEFS += -DUSB_6KRO_ENABLE
 endif
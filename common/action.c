@@ -24,19 +24,63 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_layer.h"
 #include "action_tapping.h"
 #include "action_macro.h"
+#include "action_macro_record.h"
 #include "action_util.h"
 #include "action.h"
+#include "trace.h"
 
-#ifdef DEBUG_ACTION
+#define DEBUG_MODULE    ACTION
 #include "debug.h"
-#else
-#include "nodebug.h"
+
+
+#ifndef NO_ACTION_MACRO
+#ifndef ACTION_EVENT_QUEUE_SIZE
+#define ACTION_EVENT_QUEUE_SIZE 8
+#endif
+
+/* key events while macro is playing, processed after it */
+static keyevent_t event_queue[ACTION_EVENT_QUEUE_SIZE];
+static uint8_t event_queue_head = 0;
+static uint8_t event_queue_count = 0;
+
+static keyevent_t event_queue_pop(void)
+{
+    keyevent_t event = event_queue[event_queue_head];
+    event_queue_head = (event_queue_head + 1) % ACTION_EVENT_QUEUE_SIZE;
+    event_queue_count--;
+    return event;
+}
 #endif
 
+static void action_exec_event(keyevent_t event);
 
 void action_exec(keyevent_t event)
 {
+#ifndef NO_ACTION_MACRO
+    /* Key events wait for macro playing so that their output comes after
+     * it in order. Tick is also held back not to time out tapping key whose
+     * release is waiting. */
     if (!IS_NOEVENT(event)) {
+        while (event_queue_count == ACTION_EVENT_QUEUE_SIZE) {
+            /* no room for event, play macro through to make it */
+            while (action_macro_playing()) action_macro_task();
+            action_exec_event(event_queue_pop());
+        }
+        event_queue[(event_queue_head + event_queue_count) % ACTION_EVENT_QUEUE_SIZE] = event;
+        event_queue_count++;
+    }
+    while (event_queue_count && !action_macro_playing()) {
+        action_exec_event(event_queue_pop());
+    }
+    if (!IS_NOEVENT(event) || event_queue_count || action_macro_playing()) return;
+#endif
+    action_exec_event(event);
+}
+
+static void action_exec_event(keyevent_t event)
+{
+    if (!IS_NOEVENT(event)) {
+        trace(TRACE_KEY_EVENT, event.pressed, TRACE_KEY(event.key));
         dprint("\n---- action_exec: start -----\n");
         dprint("EVENT: "); debug_event(event); dprintln();
     }
@@ -62,7 +106,13 @@ void process_action(keyrecord_t *record)
 
     if (IS_NOEVENT(event)) { return; }
 
+#ifdef MOUSEKEY_ENABLE
+    /* wheel moving by momentum stops at any key press */
+    if (event.pressed) mousekey_momentum_stop();
+#endif
+
     action_t action = layer_switch_get_action(event.key);
+    trace(TRACE_ACTION, event.pressed, action.code);
     dprint("ACTION: "); debug_action(action);
 #ifndef NO_ACTION_LAYER
     dprint(" layer_state: "); layer_debug();
@@ -79,6 +129,7 @@ void process_action(keyrecord_t *record)
                                                                 action.key.mods<<4;
                 if (event.pressed) {
                     if (mods) {
+                        action_macro_record_mods(mods, true);
                         add_weak_mods(mods);
                         send_keyboard_report();
                     }
@@ -86,6 +137,7 @@ void process_action(keyrecord_t *record)
                 } else {
                     unregister_code(action.key.code);
                     if (mods) {
+                        action_macro_record_mods(mods, false);
                         del_weak_mods(mods);
                         send_keyboard_report();
                     }
@@ -298,6 +350,12 @@ void process_action(keyrecord_t *record)
         /* Extentions */
 #ifndef NO_ACTION_MACRO
         case ACT_MACRO:
+#ifdef MACRO_RECORD_ENABLE
+            if (action.func.opt == MACRO_RECORD) {
+                if (event.pressed) action_macro_record(action.func.id);
+                break;
+            }
+#endif
             action_macro_play(action_get_macro(record, action.func.id, action.func.opt));
             break;
 #endif
@@ -401,11 +459,13 @@ void register_code(uint8_t code)
 */
 #endif
         {
+            action_macro_record_key(code, true);
             add_key(code);
             send_keyboard_report();
         }
     }
     else if IS_MOD(code) {
+        action_macro_record_key(code, true);
         add_mods(MOD_BIT(code));
         send_keyboard_report();
     }
@@ -457,10 +517,12 @@ void unregister_code(uint8_t code)
 #endif
 
     else if IS_KEY(code) {
+        action_macro_record_key(code, false);
         del_key(code);
         send_keyboard_report();
     }
     else if IS_MOD(code) {
+        action_macro_record_key(code, false);
         del_mods(MOD_BIT(code));
         send_keyboard_report();
     }
@@ -475,6 +537,7 @@ void unregister_code(uint8_t code)
 void register_mods(uint8_t mods)
 {
     if (mods) {
+        action_macro_record_mods(mods, true);
         add_mods(mods);
         send_keyboard_report();
     }
@@ -483,6 +546,7 @@ void register_mods(uint8_t mods)
 void unregister_mods(uint8_t mods)
 {
     if (mods) {
+        action_macro_record_mods(mods, false);
         del_mods(mods);
         send_keyboard_report();
     }
@@ -520,6 +584,8 @@ bool is_tap_key(keypos_t key)
         case ACT_LAYER_TAP_EXT:
             return true;
         case ACT_MACRO:
+            if (action.func.opt == MACRO_RECORD) { return false; }
+            /* fall through */
         case ACT_FUNCTION:
             if (action.func.opt & FUNC_TAP) { return true; }
             return false;
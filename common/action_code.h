@@ -84,7 +84,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * ----------------
  * ACT_MACRO(1100):
  * 1100|opt | id(8)      Macro play?
- * 1100|1111| id(8)      Macro record?
+ * 1100|1111|0|slot(7)   Macro record start/stop
+ * 1100|1111|1|slot(7)   Macro recorded play
  *
  * ACT_BACKLIGHT(1101):
  * 1101|opt |level(8)    Backlight commands
@@ -296,6 +297,11 @@ enum backlight_opt {
 #define ACTION_MACRO(id)                ACTION(ACT_MACRO, (id))
 #define ACTION_MACRO_TAP(id)            ACTION(ACT_MACRO, FUNC_TAP<<8 | (id))
 #define ACTION_MACRO_OPT(id, opt)       ACTION(ACT_MACRO, (opt)<<8 | (id))
+/* Macro record(opt 0xF is not for ACTION_MACRO_OPT) */
+#define MACRO_RECORD                    0xF
+#define MACRO_RECORD_PLAY               0x80
+#define ACTION_MACRO_RECORD(slot)       ACTION(ACT_MACRO, MACRO_RECORD<<8 | (slot))
+#define ACTION_MACRO_RECORD_PLAY(slot)  ACTION(ACT_MACRO, MACRO_RECORD<<8 | MACRO_RECORD_PLAY | (slot))
 /* Backlight */
 #define ACTION_BACKLIGHT_INCREASE()     ACTION(ACT_BACKLIGHT, BACKLIGHT_INCREASE << 8)
 #define ACTION_BACKLIGHT_DECREASE()     ACTION(ACT_BACKLIGHT, BACKLIGHT_DECREASE << 8)
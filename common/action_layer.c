@@ -4,11 +4,8 @@
 #include "util.h"
 #include "action_layer.h"
 
-#ifdef DEBUG_ACTION
+#define DEBUG_MODULE    LAYER
 #include "debug.h"
-#else
-#include "nodebug.h"
-#endif
 
 
 /* 
@@ -14,28 +14,242 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <stddef.h>
 #include "action.h"
 #include "action_util.h"
 #include "action_macro.h"
-#include "wait.h"
+#include "keycode.h"
+#include "host.h"
+#include "timer.h"
+#ifdef MACRO_RECORD_EEPROM
+#include <avr/eeprom.h>
+#endif
 
-#ifdef DEBUG_ACTION
+#define DEBUG_MODULE    ACTION
 #include "debug.h"
-#else
-#include "nodebug.h"
-#endif
 
 
 #ifndef NO_ACTION_MACRO
 
-#define MACRO_READ()  (macro = MACRO_GET(macro_p++))
-void action_macro_play(const macro_t *macro_p)
+#ifndef ACTION_MACRO_QUEUE_SIZE
+#define ACTION_MACRO_QUEUE_SIZE 4
+#endif
+
+/* kinds of macro playing */
+#define MACRO_TEXT  (MACRO_EEPROM + 1)
+
+/* macros and texts waiting for one playing to finish */
+static struct {
+    const macro_t *p;
+    uint8_t kind;
+} macro_queue[ACTION_MACRO_QUEUE_SIZE];
+static uint8_t macro_queue_head = 0;
+static uint8_t macro_queue_count = 0;
+
+/* macro playing */
+static const macro_t *macro_p = NULL;
+static uint8_t interval = 0;
+static uint16_t wait_ms = 0;
+static uint16_t wait_timer = 0;
+static uint8_t kind = MACRO_PROGMEM;
+
+/* text typing */
+static bool text_packed = false;
+static bool text_shift = false;
+/* keys pressed in one report, boot keyboard report has six */
+#define TEXT_KEYS   6
+static uint8_t text_keys[TEXT_KEYS];
+static uint8_t text_count = 0;
+
+
+static void queue_push(const macro_t *p, uint8_t k)
+{
+    if (!p) return;
+
+    /* no room in queue, play macros through to make it */
+    while (macro_queue_count == ACTION_MACRO_QUEUE_SIZE) {
+        action_macro_task();
+    }
+    uint8_t i = (macro_queue_head + macro_queue_count) % ACTION_MACRO_QUEUE_SIZE;
+    macro_queue[i].p = p;
+    macro_queue[i].kind = k;
+    macro_queue_count++;
+
+    /* commands before first wait run now as they did */
+    action_macro_task();
+}
+
+void action_macro_play(const macro_t *macro)
+{
+    queue_push(macro, MACRO_PROGMEM);
+}
+
+void action_macro_play_from(const macro_t *macro, uint8_t memory)
+{
+    queue_push(macro, memory);
+}
+
+void action_macro_type(const char *str)
+{
+    queue_push((const macro_t *)str, MACRO_TEXT);
+}
+
+/* US layout keycode of ASCII character, TEXT_SHIFT when typed with Shift */
+#define TEXT_SHIFT  0x80
+#define S(kc)       ((kc) | TEXT_SHIFT)
+static const uint8_t ascii_to_keycode[128] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    KC_BSPC, KC_TAB, KC_ENT, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, KC_ESC, 0, 0, 0, 0,
+    KC_SPC, S(KC_1), S(KC_QUOT), S(KC_3), S(KC_4), S(KC_5), S(KC_7), KC_QUOT,
+    S(KC_9), S(KC_0), S(KC_8), S(KC_EQL), KC_COMM, KC_MINS, KC_DOT, KC_SLSH,
+    KC_0, KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7,
+    KC_8, KC_9, S(KC_SCLN), KC_SCLN, S(KC_COMM), KC_EQL, S(KC_DOT), S(KC_SLSH),
+    S(KC_2), S(KC_A), S(KC_B), S(KC_C), S(KC_D), S(KC_E), S(KC_F), S(KC_G),
+    S(KC_H), S(KC_I), S(KC_J), S(KC_K), S(KC_L), S(KC_M), S(KC_N), S(KC_O),
+    S(KC_P), S(KC_Q), S(KC_R), S(KC_S), S(KC_T), S(KC_U), S(KC_V), S(KC_W),
+    S(KC_X), S(KC_Y), S(KC_Z), KC_LBRC, KC_BSLS, KC_RBRC, S(KC_6), S(KC_MINS),
+    KC_GRV, KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G,
+    KC_H, KC_I, KC_J, KC_K, KC_L, KC_M, KC_N, KC_O,
+    KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W,
+    KC_X, KC_Y, KC_Z, S(KC_LBRC), S(KC_BSLS), S(KC_RBRC), S(KC_GRV), 0,
+};
+#undef S
+
+static void text_start(void)
+{
+    /* keys are laid in report in the order of text only when report starts
+     * empty, otherwise characters are typed one by one */
+    text_packed = !has_anykey();
+    if (text_packed) clear_keys();
+    text_shift = false;
+    text_count = 0;
+}
+
+/* Sends one report which releases keys of previous one and presses following
+ * characters of text at once, as many as host still gets in order:
+ * - keys are distinct and typed with the same Shift state, which host applies
+ *   before the presses
+ * - no key is in previous report, host would see no press of it
+ * - keys are in ascending slot(6KRO) or keycode(NKRO) order, which host
+ *   orders keys pressed in the same report by
+ * Returns false when text is done. */
+static bool text_step(void)
+{
+    uint8_t codes[TEXT_KEYS];
+    uint8_t n = 0;
+    bool shift = text_shift;
+
+    while (n < (text_packed ? TEXT_KEYS : 1)) {
+        uint8_t c = pgm_read_byte(macro_p);
+        if (!c) break;
+
+        uint8_t k = (c < 0x80 ? pgm_read_byte(&ascii_to_keycode[c]) : 0);
+        uint8_t code = k & ~TEXT_SHIFT;
+        if (!code) {
+            dprintf("TEXT: no key for %02X\n", c);
+            macro_p++;
+            continue;
+        }
+        if (n && (bool)(k & TEXT_SHIFT) != shift) break;
+
+        bool used = false;
+        for (uint8_t i = 0; i < text_count; i++) {
+            if (text_keys[i] == code) used = true;
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            if (codes[i] == code) used = true;
+        }
+        if (used) break;
+#ifdef NKRO_ENABLE
+        if (keyboard_nkro && n && code < codes[n - 1]) break;
+#endif
+
+        shift = k & TEXT_SHIFT;
+        codes[n++] = code;
+        macro_p++;
+    }
+
+    if (!n && !text_count) {
+        if (text_shift) {
+            del_weak_mods(MOD_BIT(KC_LSHIFT));
+            send_keyboard_report();
+            text_shift = false;
+        }
+        return false;
+    }
+
+    /* release in reverse order so that freed slots are reused in order */
+    while (text_count) {
+        del_key(text_keys[--text_count]);
+    }
+    if (n && shift != text_shift) {
+        if (shift)
+            add_weak_mods(MOD_BIT(KC_LSHIFT));
+        else
+            del_weak_mods(MOD_BIT(KC_LSHIFT));
+        text_shift = shift;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+        add_key(codes[i]);
+        text_keys[text_count++] = codes[i];
+    }
+    dprintf("TEXT: %u keys\n", n);
+    send_keyboard_report();
+    return true;
+}
+
+bool action_macro_playing(void)
+{
+    return (macro_p || macro_queue_count);
+}
+
+static macro_t macro_get(const macro_t *p)
+{
+    switch (kind) {
+        case MACRO_RAM:
+            return *p;
+#ifdef MACRO_RECORD_EEPROM
+        case MACRO_EEPROM:
+            return eeprom_read_byte(p);
+#endif
+        default:
+            return MACRO_GET(p);
+    }
+}
+
+#define MACRO_READ()  (macro = macro_get(macro_p++))
+/* Runs macro commands until one needs to wait. Called from keyboard_task. */
+void action_macro_task(void)
 {
     macro_t macro = END;
-    uint8_t interval = 0;
 
-    if (!macro_p) return;
     while (true) {
+        if (!macro_p) {
+            if (!macro_queue_count) return;
+            macro_p = macro_queue[macro_queue_head].p;
+            kind = macro_queue[macro_queue_head].kind;
+            macro_queue_head = (macro_queue_head + 1) % ACTION_MACRO_QUEUE_SIZE;
+            macro_queue_count--;
+            interval = 0;
+            wait_ms = 0;
+            if (kind == MACRO_TEXT) text_start();
+        }
+
+        if (wait_ms) {
+            if (timer_elapsed(wait_timer) < wait_ms) return;
+            wait_ms = 0;
+        }
+
+        if (kind == MACRO_TEXT) {
+            if (!text_step()) {
+                macro_p = NULL;
+                continue;
+            }
+            return;
+        }
+
         switch (MACRO_READ()) {
             case KEY_DOWN:
                 MACRO_READ();
@@ -58,7 +272,7 @@ void action_macro_play(const macro_t *macro_p)
             case WAIT:
                 MACRO_READ();
                 dprintf("WAIT(%u)\n", macro);
-                { uint8_t ms = macro; while (ms--) wait_ms(1); }
+                wait_ms = macro;
                 break;
             case INTERVAL:
                 interval = MACRO_READ();
@@ -74,10 +288,12 @@ void action_macro_play(const macro_t *macro_p)
                 break;
             case END:
             default:
-                return;
+                macro_p = NULL;
+                continue;
         }
         // interval
-        { uint8_t ms = interval; while (ms--) wait_ms(1); }
+        wait_ms += interval;
+        wait_timer = timer_read();
     }
 }
 #endif
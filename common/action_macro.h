@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef ACTION_MACRO_H
 #define ACTION_MACRO_H
 #include <stdint.h>
+#include <stdbool.h>
 #include "progmem.h"
 
 
@@ -26,11 +27,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 typedef uint8_t macro_t;
 
+/* memory macro is in */
+enum macro_memory {
+    MACRO_PROGMEM = 0,
+    MACRO_RAM,
+    MACRO_EEPROM,
+};
+
 
 #ifndef NO_ACTION_MACRO
+/* queue macro to play, commands are run from action_macro_task */
 void action_macro_play(const macro_t *macro_p);
+void action_macro_play_from(const macro_t *macro_p, uint8_t memory);
+/* queue ASCII text in PROGMEM to type, e.g. action_macro_type(PSTR("Hello")),
+ * several characters are pressed in one report where host keeps their order */
+void action_macro_type(const char *str);
+void action_macro_task(void);
+bool action_macro_playing(void);
 #else
 #define action_macro_play(macro)
+#define action_macro_play_from(macro, memory)
+#define action_macro_type(str)
+#define action_macro_task()
+#define action_macro_playing()  false
 #endif
 
 
@@ -0,0 +1,188 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "keycode.h"
+#include "timer.h"
+#include "action_code.h"
+#include "action_macro.h"
+#include "action_macro_record.h"
+#ifdef MACRO_RECORD_EEPROM
+#include <avr/eeprom.h>
+#include "eeconfig.h"
+
+/* slots from EECONFIG_MACRO_RECORD(16) */
+#if 16 + MACRO_RECORD_SLOTS * MACRO_RECORD_SIZE > E2END + 1
+#error "MACRO_RECORD_SLOTS * MACRO_RECORD_SIZE exceeds EEPROM."
+#endif
+#endif
+
+#define DEBUG_MODULE    ACTION
+#include "debug.h"
+
+
+/*
+ * Key events are recorded as macro commands action_macro_play runs:
+ * keycode(0x04-0x73) or keycode|0x80 for key, KEY_DOWN/KEY_UP with keycode
+ * for other keys and modifiers, and WAIT with time from previous event up to
+ * 255ms.
+ *
+ * Recorded macros are in RAM, or saved to EEPROM when MACRO_RECORD_EEPROM is
+ * defined and then only one buffer is in RAM for recording.
+ */
+#ifdef MACRO_RECORD_EEPROM
+static macro_t record_buf[1][MACRO_RECORD_SIZE];
+#define RECORD_BUF(slot)    record_buf[0]
+#else
+static macro_t record_buf[MACRO_RECORD_SLOTS][MACRO_RECORD_SIZE];
+#define RECORD_BUF(slot)    record_buf[slot]
+#endif
+
+#define NOT_RECORDING   0xFF
+static uint8_t record_slot = NOT_RECORDING;
+static uint8_t record_len = 0;
+static uint16_t record_timer = 0;
+
+/* keys pressed in recording, released at the end of macro if still held */
+static uint8_t record_keys[MACRO_RECORD_KEYS];
+static uint8_t record_held = 0;
+
+
+/* keycode has one byte command up to 0x73, above it would be WAIT, INTERVAL
+ * or key up and KEY_DOWN/KEY_UP with keycode is used */
+#define RECORD_ONE_BYTE(code)   ((code) <= 0x73)
+#define RECORD_SIZE(code)       (RECORD_ONE_BYTE(code) ? 1 : 2)
+
+static void record_byte(uint8_t b)
+{
+    macro_t *buf = RECORD_BUF(record_slot);
+    buf[record_len++] = b;
+    buf[record_len] = END;
+}
+
+static void record_event(uint8_t code, bool pressed)
+{
+    uint8_t size = RECORD_SIZE(code);
+    uint16_t elapsed = timer_elapsed(record_timer);
+    uint8_t wait = (!record_len ? 0 : (elapsed > 255 ? 255 : elapsed));
+    /* room for END and releases of keys held */
+    uint8_t reserve = 1;
+    for (uint8_t i = 0; i < record_held; i++) {
+        reserve += RECORD_SIZE(record_keys[i]);
+    }
+
+    if (pressed) {
+        if (record_held == MACRO_RECORD_KEYS) return;
+        /* press and room for its release */
+        if (record_len + (wait ? 2 : 0) + size * 2 + reserve > MACRO_RECORD_SIZE) {
+            dprintf("MACRO_RECORD: full\n");
+            return;
+        }
+        record_keys[record_held++] = code;
+    } else {
+        uint8_t i = 0;
+        while (i < record_held && record_keys[i] != code) i++;
+        /* not pressed in recording */
+        if (i == record_held) return;
+        record_keys[i] = record_keys[--record_held];
+
+        /* release always fits in room reserved for it, wait may not */
+        if (record_len + (wait ? 2 : 0) + reserve > MACRO_RECORD_SIZE) {
+            wait = 0;
+        }
+    }
+
+    if (wait) {
+        record_byte(WAIT);
+        record_byte(wait);
+    }
+    if (RECORD_ONE_BYTE(code)) {
+        record_byte(pressed ? code : code | 0x80);
+    } else {
+        record_byte(pressed ? KEY_DOWN : KEY_UP);
+        record_byte(code);
+    }
+    record_timer = timer_read();
+}
+
+static void record_start(uint8_t slot)
+{
+    dprintf("MACRO_RECORD: start %u\n", slot);
+    record_slot = slot;
+    record_len = 0;
+    record_held = 0;
+    RECORD_BUF(slot)[0] = END;
+}
+
+static void record_stop(void)
+{
+    while (record_held) {
+        record_event(record_keys[record_held - 1], false);
+    }
+#ifdef MACRO_RECORD_EEPROM
+    eeprom_update_block(record_buf[0], EECONFIG_MACRO_RECORD + record_slot * MACRO_RECORD_SIZE,
+                        record_len + 1);
+#endif
+    dprintf("MACRO_RECORD: stop %u(%u bytes)\n", record_slot, record_len);
+    record_slot = NOT_RECORDING;
+}
+
+static void record_play(uint8_t slot)
+{
+    /* not while being written */
+    if (slot == record_slot) return;
+
+#ifdef MACRO_RECORD_EEPROM
+    action_macro_play_from(EECONFIG_MACRO_RECORD + slot * MACRO_RECORD_SIZE, MACRO_EEPROM);
+#else
+    action_macro_play_from(record_buf[slot], MACRO_RAM);
+#endif
+}
+
+void action_macro_record(uint8_t id)
+{
+    uint8_t slot = id & ~MACRO_RECORD_PLAY;
+    if (slot >= MACRO_RECORD_SLOTS) return;
+
+    if (id & MACRO_RECORD_PLAY) {
+        record_play(slot);
+    } else if (record_slot != NOT_RECORDING) {
+        record_stop();
+    } else {
+        record_start(slot);
+    }
+}
+
+void action_macro_record_key(uint8_t code, bool pressed)
+{
+    if (record_slot == NOT_RECORDING) return;
+    if (!IS_KEY(code) && !IS_MOD(code)) return;
+    record_event(code, pressed);
+}
+
+void action_macro_record_mods(uint8_t mods, bool pressed)
+{
+    if (record_slot == NOT_RECORDING) return;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (mods & (1<<i)) record_event(KC_LCTRL + i, pressed);
+    }
+}
+
+bool action_macro_recording(void)
+{
+    return (record_slot != NOT_RECORDING);
+}
@@ -0,0 +1,64 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef ACTION_MACRO_RECORD_H
+#define ACTION_MACRO_RECORD_H
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* number of macros recorded */
+#ifndef MACRO_RECORD_SLOTS
+#define MACRO_RECORD_SLOTS  2
+#endif
+
+/* bytes of one recorded macro, four bytes per key event at most */
+#ifndef MACRO_RECORD_SIZE
+#define MACRO_RECORD_SIZE   64
+#endif
+
+/* keys held in recording at once */
+#ifndef MACRO_RECORD_KEYS
+#define MACRO_RECORD_KEYS   8
+#endif
+
+#if MACRO_RECORD_SIZE < 8 || MACRO_RECORD_SIZE > 255
+#error "MACRO_RECORD_SIZE must be 8-255."
+#endif
+
+
+#ifdef MACRO_RECORD_ENABLE
+#ifdef NO_ACTION_MACRO
+#error "MACRO_RECORD_ENABLE needs macro action, remove NO_ACTION_MACRO."
+#endif
+#if defined(MACRO_RECORD_EEPROM) && !defined(BOOTMAGIC_ENABLE)
+#error "MACRO_RECORD_EEPROM needs eeconfig of BOOTMAGIC_ENABLE."
+#endif
+
+/* id of ACTION_MACRO_RECORD: start/stop recording or play */
+void action_macro_record(uint8_t id);
+/* key and modifier changes to record, from register_code and the like */
+void action_macro_record_key(uint8_t code, bool pressed);
+void action_macro_record_mods(uint8_t mods, bool pressed);
+bool action_macro_recording(void);
+#else
+#define action_macro_record(id)
+#define action_macro_record_key(code, pressed)
+#define action_macro_record_mods(mods, pressed)
+#define action_macro_recording()    false
+#endif
+
+#endif
@@ -5,12 +5,10 @@
 #include "action_tapping.h"
 #include "keycode.h"
 #include "timer.h"
+#include "trace.h"
 
-#ifdef DEBUG_ACTION
+#define DEBUG_MODULE    TAPPING
 #include "debug.h"
-#else
-#include "nodebug.h"
-#endif
 
 #ifndef NO_ACTION_TAPPING
 
@@ -301,6 +299,7 @@ bool waiting_buffer_enq(keyrecord_t record)
         return false;
     }
 
+    trace(TRACE_WAITING_ENQ, waiting_buffer_head, TRACE_KEY(record.event.key));
     waiting_buffer[waiting_buffer_head] = record;
     waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
 
@@ -361,16 +360,24 @@ void waiting_buffer_scan_tap(void)
  */
 static void debug_tapping_key(void)
 {
+    trace(TRACE_TAPPING_KEY, (tapping_key.tap.interrupted ? TRACE_TAP_INTERRUPTED : 0) |
+                             (tapping_key.event.pressed ? TRACE_TAP_PRESSED : 0) |
+                             tapping_key.tap.count,
+          TRACE_KEY(tapping_key.event.key));
+#if DEBUG_MODULE_LEVEL >= DEBUG_LEVEL_VERBOSE
     debug("TAPPING_KEY="); debug_record(tapping_key); debug("\n");
+#endif
 }
 
 static void debug_waiting_buffer(void)
 {
+#if DEBUG_MODULE_LEVEL >= DEBUG_LEVEL_VERBOSE
     debug("{ ");
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
         debug("["); debug_dec(i); debug("]="); debug_record(waiting_buffer[i]); debug(" ");
     }
     debug("}\n");
+#endif
 }
 
 #endif
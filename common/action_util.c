@@ -30,14 +30,23 @@ static inline void del_key_bit(uint8_t code);
 static uint8_t real_mods = 0;
 static uint8_t weak_mods = 0;
 
+#ifdef NKRO_ENABLE
+/* number of keys and lowest keycode on in NKRO bitmap, kept by add/del_key_bit */
+static uint8_t nkro_count = 0;
+static uint8_t nkro_first = 0;
+#endif
+
 #ifdef USB_6KRO_ENABLE
-#define RO_ADD(a, b) ((a + b) % KEYBOARD_REPORT_KEYS)
-#define RO_SUB(a, b) ((a - b + KEYBOARD_REPORT_KEYS) % KEYBOARD_REPORT_KEYS)
-#define RO_INC(a) RO_ADD(a, 1)
-#define RO_DEC(a) RO_SUB(a, 1)
-static int8_t cb_head = 0;
-static int8_t cb_tail = 0;
-static int8_t cb_count = 0;
+/* Slots of keys[] are chained from oldest to newest key so that the oldest
+ * one can be replaced when a key is added to full report. Released slots are
+ * chained in free list and reused before slots not used yet since clear. */
+#define RO_NONE 0xFF
+static uint8_t ro_next[KEYBOARD_REPORT_KEYS];
+static uint8_t ro_prev[KEYBOARD_REPORT_KEYS];
+static uint8_t ro_head = RO_NONE;   // oldest
+static uint8_t ro_tail = RO_NONE;   // newest
+static uint8_t ro_free = RO_NONE;
+static uint8_t ro_unused = 0;
 #endif
 
 // TODO: pointer variable is not needed
@@ -101,6 +110,14 @@ void clear_keys(void)
     for (int8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
         keyboard_report->raw[i] = 0;
     }
+#ifdef NKRO_ENABLE
+    nkro_count = 0;
+    nkro_first = 0;
+#endif
+#ifdef USB_6KRO_ENABLE
+    ro_head = ro_tail = ro_free = RO_NONE;
+    ro_unused = 0;
+#endif
 }
 
 
@@ -144,6 +161,11 @@ void clear_oneshot_mods(void)
  */
 uint8_t has_anykey(void)
 {
+#ifdef NKRO_ENABLE
+    if (keyboard_nkro) {
+        return nkro_count;
+    }
+#endif
     uint8_t cnt = 0;
     for (uint8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
         if (keyboard_report->raw[i])
@@ -161,21 +183,12 @@ uint8_t get_first_key(void)
 {
 #ifdef NKRO_ENABLE
     if (keyboard_nkro) {
-        uint8_t i = 0;
-        for (; i < KEYBOARD_REPORT_BITS && !keyboard_report->nkro.bits[i]; i++)
-            ;
-        return i<<3 | biton(keyboard_report->nkro.bits[i]);
+        return nkro_first;
     }
 #endif
 #ifdef USB_6KRO_ENABLE
-    uint8_t i = cb_head;
-    do {
-        if (keyboard_report->keys[i] != 0) {
-            break;
-        }
-        i = RO_INC(i);
-    } while (i != cb_tail);
-    return keyboard_report->keys[i];
+    if (ro_head == RO_NONE) return 0;
+    return keyboard_report->keys[ro_head];
 #else
     return keyboard_report->keys[0];
 #endif
@@ -184,53 +197,47 @@ uint8_t get_first_key(void)
 
 
 /* local functions */
+#ifdef USB_6KRO_ENABLE
+static inline uint8_t ro_find(uint8_t code)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (keyboard_report->keys[i] == code) return i;
+    }
+    return RO_NONE;
+}
+
+static inline void ro_unlink(uint8_t slot)
+{
+    uint8_t prev = ro_prev[slot];
+    uint8_t next = ro_next[slot];
+    if (prev == RO_NONE) ro_head = next; else ro_next[prev] = next;
+    if (next == RO_NONE) ro_tail = prev; else ro_prev[next] = prev;
+}
+#endif
+
 static inline void add_key_byte(uint8_t code)
 {
 #ifdef USB_6KRO_ENABLE
-    int8_t i = cb_head;
-    int8_t empty = -1;
-    if (cb_count) {
-        do {
-            if (keyboard_report->keys[i] == code) {
-                return;
-            }
-            if (empty == -1 && keyboard_report->keys[i] == 0) {
-                empty = i;
-            }
-            i = RO_INC(i);
-        } while (i != cb_tail);
-        if (i == cb_tail) {
-            if (cb_tail == cb_head) {
-                // buffer is full
-                if (empty == -1) {
-                    // pop head when has no empty space
-                    cb_head = RO_INC(cb_head);
-                    cb_count--;
-                }
-                else {
-                    // left shift when has empty space
-                    uint8_t offset = 1;
-                    i = RO_INC(empty);
-                    do {
-                        if (keyboard_report->keys[i] != 0) {
-                            keyboard_report->keys[empty] = keyboard_report->keys[i];
-                            keyboard_report->keys[i] = 0;
-                            empty = RO_INC(empty);
-                        }
-                        else {
-                            offset++;
-                        }
-                        i = RO_INC(i);
-                    } while (i != cb_tail);
-                    cb_tail = RO_SUB(cb_tail, offset);
-                }
-            }
-        }
+    if (!code || ro_find(code) != RO_NONE) return;
+
+    uint8_t slot;
+    if (ro_free != RO_NONE) {
+        slot = ro_free;
+        ro_free = ro_next[slot];
+    } else if (ro_unused < KEYBOARD_REPORT_KEYS) {
+        slot = ro_unused++;
+    } else {
+        // full: replace oldest key
+        slot = ro_head;
+        ro_unlink(slot);
     }
+
     // add to tail
-    keyboard_report->keys[cb_tail] = code;
-    cb_tail = RO_INC(cb_tail);
-    cb_count++;
+    keyboard_report->keys[slot] = code;
+    ro_prev[slot] = ro_tail;
+    ro_next[slot] = RO_NONE;
+    if (ro_tail == RO_NONE) ro_head = slot; else ro_next[ro_tail] = slot;
+    ro_tail = slot;
 #else
     int8_t i = 0;
     int8_t empty = -1;
@@ -253,30 +260,13 @@ static inline void add_key_byte(uint8_t code)
 static inline void del_key_byte(uint8_t code)
 {
 #ifdef USB_6KRO_ENABLE
-    uint8_t i = cb_head;
-    if (cb_count) {
-        do {
-            if (keyboard_report->keys[i] == code) {
-                keyboard_report->keys[i] = 0;
-                cb_count--;
-                if (cb_count == 0) {
-                    // reset head and tail
-                    cb_tail = cb_head = 0;
-                }
-                if (i == RO_DEC(cb_tail)) {
-                    // left shift when next to tail
-                    do {
-                        cb_tail = RO_DEC(cb_tail);
-                        if (keyboard_report->keys[RO_DEC(cb_tail)] != 0) {
-                            break;
-                        }
-                    } while (cb_tail != cb_head);
-                }
-                break;
-            }
-            i = RO_INC(i);
-        } while (i != cb_tail);
-    }
+    uint8_t slot = code ? ro_find(code) : RO_NONE;
+    if (slot == RO_NONE) return;
+
+    keyboard_report->keys[slot] = 0;
+    ro_unlink(slot);
+    ro_next[slot] = ro_free;
+    ro_free = slot;
 #else
     for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
         if (keyboard_report->keys[i] == code) {
@@ -290,7 +280,13 @@ static inline void del_key_byte(uint8_t code)
 static inline void add_key_bit(uint8_t code)
 {
     if ((code>>3) < KEYBOARD_REPORT_BITS) {
-        keyboard_report->nkro.bits[code>>3] |= 1<<(code&7);
+        uint8_t *bits = &keyboard_report->nkro.bits[code>>3];
+        uint8_t mask = 1<<(code&7);
+        if (*bits & mask) return;
+        *bits |= mask;
+        if (!nkro_count++ || code < nkro_first) {
+            nkro_first = code;
+        }
     } else {
         dprintf("add_key_bit: can't add: %02X\n", code);
     }
@@ -299,7 +295,23 @@ static inline void add_key_bit(uint8_t code)
 static inline void del_key_bit(uint8_t code)
 {
     if ((code>>3) < KEYBOARD_REPORT_BITS) {
-        keyboard_report->nkro.bits[code>>3] &= ~(1<<(code&7));
+        uint8_t *bits = &keyboard_report->nkro.bits[code>>3];
+        uint8_t mask = 1<<(code&7);
+        if (!(*bits & mask)) return;
+        *bits &= ~mask;
+        if (!--nkro_count) {
+            nkro_first = 0;
+        } else if (code == nkro_first) {
+            /* next key on is always above the removed lowest one */
+            uint8_t i = code>>3;
+            uint8_t b = *bits & ~(mask - 1);
+            while (!b) {
+                b = keyboard_report->nkro.bits[++i];
+            }
+            code = i<<3;
+            for (; !(b & 1); b >>= 1) code++;
+            nkro_first = code;
+        }
     } else {
         dprintf("del_key_bit: can't del: %02X\n", code);
     }
@@ -2,6 +2,9 @@
 #include <stdbool.h>
 #include <avr/eeprom.h>
 #include "eeconfig.h"
+#ifdef MACRO_RECORD_ENABLE
+#include "action_macro_record.h"
+#endif
 
 void eeconfig_init(void)
 {
@@ -13,6 +16,14 @@ void eeconfig_init(void)
 #ifdef BACKLIGHT_ENABLE
     eeprom_write_byte(EECONFIG_BACKLIGHT,      0);
 #endif
+#ifdef MOUSEKEY_ENABLE
+    eeprom_write_byte(EECONFIG_MOUSEKEY_PARAMS, 0);
+#endif
+#if defined(MACRO_RECORD_ENABLE) && defined(MACRO_RECORD_EEPROM)
+    for (uint8_t i = 0; i < MACRO_RECORD_SLOTS; i++) {
+        eeprom_write_byte(EECONFIG_MACRO_RECORD + i * MACRO_RECORD_SIZE, 0);
+    }
+#endif
 }
 
 void eeconfig_enable(void)
@@ -43,3 +54,8 @@ void eeconfig_write_keymap(uint8_t val) { eeprom_write_byte(EECONFIG_KEYMAP, val
 uint8_t eeconfig_read_backlight(void)      { return eeprom_read_byte(EECONFIG_BACKLIGHT); }
 void eeconfig_write_backlight(uint8_t val) { eeprom_write_byte(EECONFIG_BACKLIGHT, val); }
 #endif
+
+#ifdef MOUSEKEY_ENABLE
+void eeconfig_read_mousekey(uint8_t *buf)        { eeprom_read_block(buf, EECONFIG_MOUSEKEY_PARAMS, EECONFIG_MOUSEKEY_PARAMS_SIZE); }
+void eeconfig_write_mousekey(const uint8_t *buf) { eeprom_update_block(buf, EECONFIG_MOUSEKEY_PARAMS, EECONFIG_MOUSEKEY_PARAMS_SIZE); }
+#endif
@@ -9,6 +9,9 @@
 #include "action_layer.h"
 #include "eeconfig.h"
 #include "bootmagic.h"
+#ifdef MOUSEKEY_ENABLE
+#include "mousekey.h"
+#endif
 
 
 void bootmagic(void)
@@ -86,6 +89,11 @@ void bootmagic(void)
     keyboard_nkro = keymap_config.nkro;
 #endif
 
+#ifdef MOUSEKEY_ENABLE
+    /* mousekey parameters saved in mousekey console */
+    mousekey_load_params();
+#endif
+
     /* default layer */
     uint8_t default_layer = 0;
     if (bootmagic_scan_keycode(BOOTMAGIC_KEY_DEFAULT_LAYER_0)) { default_layer |= (1<<0); }
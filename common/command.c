@@ -40,11 +40,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef PROTOCOL_PJRC
 #   include "usb_keyboard.h"
+#   include "usb_debug.h"
 #   ifdef EXTRAKEY_ENABLE
 #       include "usb_extra.h"
 #   endif
 #endif
 
+#ifdef PROTOCOL_LUFA
+#   include "lufa.h"
+#endif
+
 #ifdef PROTOCOL_VUSB
 #   include "usbdrv.h"
 #endif
@@ -315,7 +320,15 @@ static bool command_common(uint8_t code)
             print_val_hex8(host_keyboard_leds());
             print_val_hex8(keyboard_protocol);
             print_val_hex8(keyboard_idle);
+            print_val_dec(host_keyboard_suppressed());
+#ifdef PROTOCOL_LUFA
+            print_val_dec(kbuf_overflow);
+#ifdef CONSOLE_ENABLE
+            print_val_dec(console_dropped);
+#endif
+#endif
 #ifdef PROTOCOL_PJRC
+            print_val_dec(debug_dropped);
             print_val_hex8(UDCON);
             print_val_hex8(UDIEN);
             print_val_hex8(UDINT);
@@ -384,6 +397,7 @@ static void command_console_help(void)
 {
     print("\n\n----- Console Help -----\n");
     print("ESC/q:	quit\n");
+    print("1-5:	toggle debug of action/tapping/layer/host/mousekey\n");
 #ifdef MOUSEKEY_ENABLE
     print("m:	mousekey\n");
 #endif
@@ -401,6 +415,11 @@ static bool command_console(uint8_t code)
             print("\nQuit Console Mode\n");
             command_state = ONESHOT;
             return false;
+        case KC_1 ... KC_5:
+            // bits of debug_modules from DEBUG_MASK_ACTION in the order of help
+            debug_modules ^= 1<<(code - KC_1);
+            print("\ndebug_modules: "); print_bin8(debug_modules); print("\n");
+            break;
 #ifdef MOUSEKEY_ENABLE
         case KC_M:
             mousekey_console_help();
@@ -433,9 +452,12 @@ static void mousekey_param_print(void)
     print("4: mk_time_to_max: "); pdec(mk_time_to_max); print("\n");
     print("5: mk_wheel_max_speed: "); pdec(mk_wheel_max_speed); print("\n");
     print("6: mk_wheel_time_to_max: "); pdec(mk_wheel_time_to_max); print("\n");
+    print("7: mk_curve: "); print_decs(mk_curve); print("\n");
+    print("8: mk_wheel_momentum: "); pdec(mk_wheel_momentum); print("\n");
 }
 
 #define PRINT_SET_VAL(v)  print(#v " = "); print_dec(v); print("\n");
+#define PRINT_SET_SVAL(v) print(#v " = "); print_decs(v); print("\n");
 static void mousekey_param_inc(uint8_t param, uint8_t inc)
 {
     switch (param) {
@@ -481,6 +503,20 @@ static void mousekey_param_inc(uint8_t param, uint8_t inc)
                 mk_wheel_time_to_max = UINT8_MAX;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve + inc < 100)
+                mk_curve += inc;
+            else
+                mk_curve = 100;
+            PRINT_SET_SVAL(mk_curve);
+            break;
+        case 8:
+            if (mk_wheel_momentum + inc < 8)
+                mk_wheel_momentum += inc;
+            else
+                mk_wheel_momentum = 8;
+            PRINT_SET_VAL(mk_wheel_momentum);
+            break;
     }
 }
 
@@ -529,6 +565,20 @@ static void mousekey_param_dec(uint8_t param, uint8_t dec)
                 mk_wheel_time_to_max = 0;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve - dec > -100)
+                mk_curve -= dec;
+            else
+                mk_curve = -100;
+            PRINT_SET_SVAL(mk_curve);
+            break;
+        case 8:
+            if (mk_wheel_momentum > dec)
+                mk_wheel_momentum -= dec;
+            else
+                mk_wheel_momentum = 0;
+            PRINT_SET_VAL(mk_wheel_momentum);
+            break;
     }
 }
 
@@ -542,13 +592,16 @@ static void mousekey_console_help(void)
     print("4:	select mk_time_to_max\n");
     print("5:	select mk_wheel_max_speed\n");
     print("6:	select mk_wheel_time_to_max\n");
+    print("7:	select mk_curve\n");
+    print("8:	select mk_wheel_momentum(0:off)\n");
     print("p:	print parameters\n");
     print("d:	set default values\n");
     print("up:	increase parameters(+1)\n");
     print("down:	decrease parameters(-1)\n");
     print("pgup:	increase parameters(+10)\n");
     print("pgdown:	decrease parameters(-10)\n");
-    print("\nspeed = delta * max_speed * (repeat / time_to_max)\n");
+    print("\nspeed = delta * max_speed * (time / time_to_max)**((100+curve)/100)\n");
+    print("where speed and time are in interval of "); pdec(MOUSEKEY_INTERVAL); print("ms\n");
     print("where delta: cursor="); pdec(MOUSEKEY_MOVE_DELTA);
     print(", wheel="); pdec(MOUSEKEY_WHEEL_DELTA); print("\n");
     print("See http://en.wikipedia.org/wiki/Mouse_keys\n");
@@ -564,6 +617,10 @@ static bool mousekey_console(uint8_t code)
         case KC_Q:
         case KC_ESC:
             mousekey_param = 0;
+#ifdef BOOTMAGIC_ENABLE
+            mousekey_save_params();
+            print("\nSaved Mousekey Parameters");
+#endif
             print("\nQuit Mousekey Console\n");
             print("C> ");
             command_state = CONSOLE;
@@ -601,8 +658,10 @@ static bool mousekey_console(uint8_t code)
             mk_interval = MOUSEKEY_INTERVAL;
             mk_max_speed = MOUSEKEY_MAX_SPEED;
             mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
+            mk_curve = MOUSEKEY_CURVE;
             mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
             mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+            mk_wheel_momentum = MOUSEKEY_WHEEL_MOMENTUM;
             print("set default values.\n");
             break;
         default:
@@ -3,6 +3,9 @@
 
 #define GCC_VERSION (__GNUC__ * 10000 + __GNUC_MINOR__ * 100 + __GNUC_PATCHLEVEL__)
 
+/* modules printing debug output, DEBUG_MASK_* */
+uint8_t debug_modules = 0xFF;
+
 debug_config_t debug_config = {
 /* GCC Bug 10676 - Using unnamed fields in initializers
  * https://gcc.gnu.org/bugzilla/show_bug.cgi?id=10676 */
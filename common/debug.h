@@ -53,41 +53,117 @@ extern debug_config_t debug_config;
 #define debug_mouse     (debug_config.mouse)
 
 
+/*
+ * Module debug level
+ *
+ * Source file of module defines DEBUG_MODULE before including debug.h, then
+ * DEBUG_LEVEL_<module> in config.h decides what output is compiled in:
+ *   0: nothing, neither strings nor checks remain in firmware
+ *   1: messages
+ *   2: messages and verbose dumps
+ *
+ *   #define DEBUG_MODULE    TAPPING
+ *   #include "debug.h"
+ *
+ * Output compiled in is printed when debug_enable and bit of the module in
+ * debug_modules are set. Files without DEBUG_MODULE are gated by debug_enable
+ * only as before.
+ */
+#define DEBUG_LEVEL_NONE        0
+#define DEBUG_LEVEL_MESSAGE     1
+#define DEBUG_LEVEL_VERBOSE     2
+
+/* action modules are compiled in with DEBUG_ACTION as before */
+#ifdef DEBUG_ACTION
+#   define DEBUG_LEVEL_ACTION_DEFAULT   DEBUG_LEVEL_VERBOSE
+#else
+#   define DEBUG_LEVEL_ACTION_DEFAULT   DEBUG_LEVEL_NONE
+#endif
+#ifndef DEBUG_LEVEL_ACTION
+#define DEBUG_LEVEL_ACTION      DEBUG_LEVEL_ACTION_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_TAPPING
+#define DEBUG_LEVEL_TAPPING     DEBUG_LEVEL_ACTION_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_LAYER
+#define DEBUG_LEVEL_LAYER       DEBUG_LEVEL_ACTION_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_HOST
+#define DEBUG_LEVEL_HOST        DEBUG_LEVEL_VERBOSE
+#endif
+#ifndef DEBUG_LEVEL_MOUSEKEY
+#define DEBUG_LEVEL_MOUSEKEY    DEBUG_LEVEL_VERBOSE
+#endif
+
+/* bits of debug_modules */
+#define DEBUG_MASK_ACTION       (1<<0)
+#define DEBUG_MASK_TAPPING      (1<<1)
+#define DEBUG_MASK_LAYER        (1<<2)
+#define DEBUG_MASK_HOST         (1<<3)
+#define DEBUG_MASK_MOUSEKEY     (1<<4)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern uint8_t debug_modules;
+#ifdef __cplusplus
+}
+#endif
+
+#define DEBUG_CAT(a, b)         DEBUG_CAT_(a, b)
+#define DEBUG_CAT_(a, b)        a##b
+
+#if defined(NO_DEBUG)
+#   define DEBUG_MODULE_LEVEL   DEBUG_LEVEL_NONE
+#elif defined(DEBUG_MODULE)
+#   define DEBUG_MODULE_LEVEL   DEBUG_CAT(DEBUG_LEVEL_, DEBUG_MODULE)
+#else
+#   define DEBUG_MODULE_LEVEL   DEBUG_LEVEL_VERBOSE
+#endif
+
+#ifdef DEBUG_MODULE
+#   define debug_module_enable  (debug_modules & DEBUG_CAT(DEBUG_MASK_, DEBUG_MODULE))
+#else
+#   define debug_module_enable  true
+#endif
+#define DEBUG_ON                (debug_enable && debug_module_enable)
+
+
 /*
  * Debug print utils
  */
-#ifndef NO_DEBUG
+#if DEBUG_MODULE_LEVEL > DEBUG_LEVEL_NONE
 
-#define dprint(s)                   do { if (debug_enable) print(s); } while (0)
-#define dprintln(s)                 do { if (debug_enable) println(s); } while (0)
-#define dprintf(fmt, ...)           do { if (debug_enable) xprintf(fmt, ##__VA_ARGS__); } while (0)
+#define dprint(s)                   do { if (DEBUG_ON) print(s); } while (0)
+#define dprintln(s)                 do { if (DEBUG_ON) println(s); } while (0)
+#define dprintf(fmt, ...)           do { if (DEBUG_ON) xprintf(fmt, ##__VA_ARGS__); } while (0)
 #define dmsg(s)                     dprintf("%s at %s: %S\n", __FILE__, __LINE__, PSTR(s))
 
 /* Deprecated. DO NOT USE these anymore, use dprintf instead. */
-#define debug(s)                    do { if (debug_enable) print(s); } while (0)
-#define debugln(s)                  do { if (debug_enable) println(s); } while (0)
+#define debug(s)                    do { if (DEBUG_ON) print(s); } while (0)
+#define debugln(s)                  do { if (DEBUG_ON) println(s); } while (0)
 #define debug_msg(s)                do { \
-    if (debug_enable) { \
+    if (DEBUG_ON) { \
         print(__FILE__); print(" at "); print_dec(__LINE__); print(" in "); print(": "); print(s); \
     } \
 } while (0)
-#define debug_dec(data)             do { if (debug_enable) print_dec(data); } while (0)
-#define debug_decs(data)            do { if (debug_enable) print_decs(data); } while (0)
-#define debug_hex4(data)            do { if (debug_enable) print_hex4(data); } while (0)
-#define debug_hex8(data)            do { if (debug_enable) print_hex8(data); } while (0)
-#define debug_hex16(data)           do { if (debug_enable) print_hex16(data); } while (0)
-#define debug_hex32(data)           do { if (debug_enable) print_hex32(data); } while (0)
-#define debug_bin8(data)            do { if (debug_enable) print_bin8(data); } while (0)
-#define debug_bin16(data)           do { if (debug_enable) print_bin16(data); } while (0)
-#define debug_bin32(data)           do { if (debug_enable) print_bin32(data); } while (0)
-#define debug_bin_reverse8(data)    do { if (debug_enable) print_bin_reverse8(data); } while (0)
-#define debug_bin_reverse16(data)   do { if (debug_enable) print_bin_reverse16(data); } while (0)
-#define debug_bin_reverse32(data)   do { if (debug_enable) print_bin_reverse32(data); } while (0)
+#define debug_dec(data)             do { if (DEBUG_ON) print_dec(data); } while (0)
+#define debug_decs(data)            do { if (DEBUG_ON) print_decs(data); } while (0)
+#define debug_hex4(data)            do { if (DEBUG_ON) print_hex4(data); } while (0)
+#define debug_hex8(data)            do { if (DEBUG_ON) print_hex8(data); } while (0)
+#define debug_hex16(data)           do { if (DEBUG_ON) print_hex16(data); } while (0)
+#define debug_hex32(data)           do { if (DEBUG_ON) print_hex32(data); } while (0)
+#define debug_bin8(data)            do { if (DEBUG_ON) print_bin8(data); } while (0)
+#define debug_bin16(data)           do { if (DEBUG_ON) print_bin16(data); } while (0)
+#define debug_bin32(data)           do { if (DEBUG_ON) print_bin32(data); } while (0)
+#define debug_bin_reverse8(data)    do { if (DEBUG_ON) print_bin_reverse8(data); } while (0)
+#define debug_bin_reverse16(data)   do { if (DEBUG_ON) print_bin_reverse16(data); } while (0)
+#define debug_bin_reverse32(data)   do { if (DEBUG_ON) print_bin_reverse32(data); } while (0)
 #define debug_hex(data)             debug_hex8(data)
 #define debug_bin(data)             debug_bin8(data)
 #define debug_bin_reverse(data)     debug_bin8(data)
 
-#else /* NO_DEBUG */
+#else /* DEBUG_LEVEL_NONE */
 
 #define dprint(s)
 #define dprintln(s)
@@ -112,6 +188,6 @@ extern debug_config_t debug_config;
 #define debug_bin(data)
 #define debug_bin_reverse(data)
 
-#endif /* NO_DEBUG */
+#endif /* DEBUG_MODULE_LEVEL */
 
 #endif
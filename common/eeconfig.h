@@ -31,6 +31,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define EECONFIG_KEYMAP                             (uint8_t *)4
 #define EECONFIG_MOUSEKEY_ACCEL                     (uint8_t *)5
 #define EECONFIG_BACKLIGHT                          (uint8_t *)6
+#define EECONFIG_MOUSEKEY_PARAMS                    (uint8_t *)7
+#define EECONFIG_MACRO_RECORD                       (uint8_t *)16
+
+#define EECONFIG_MOUSEKEY_PARAMS_SIZE               9
 
 
 /* debug bit */
@@ -72,4 +76,9 @@ uint8_t eeconfig_read_backlight(void);
 void eeconfig_write_backlight(uint8_t val);
 #endif
 
+#ifdef MOUSEKEY_ENABLE
+void eeconfig_read_mousekey(uint8_t *buf);
+void eeconfig_write_mousekey(const uint8_t *buf);
+#endif
+
 #endif
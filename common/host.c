@@ -20,16 +20,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "keycode.h"
 #include "host.h"
 #include "util.h"
+#define DEBUG_MODULE    HOST
 #include "debug.h"
+#include "trace.h"
 
 
 #ifdef NKRO_ENABLE
 bool keyboard_nkro = true;
 #endif
+#ifdef MOUSE_WHEEL_HIRES
+uint8_t mouse_resolution_multiplier = 0;
+#endif
 
 static host_driver_t *driver;
 static uint16_t last_system_report = 0;
 static uint16_t last_consumer_report = 0;
+static report_keyboard_t last_keyboard_report;
+#ifdef NKRO_ENABLE
+static bool last_keyboard_nkro = false;
+#endif
+static uint16_t keyboard_report_suppressed = 0;
 
 
 void host_set_driver(host_driver_t *d)
@@ -51,8 +61,30 @@ uint8_t host_keyboard_leds(void)
 void host_keyboard_send(report_keyboard_t *report)
 {
     if (!driver) return;
+
+    /* skip report identical to the last one sent */
+#ifdef NKRO_ENABLE
+    if (keyboard_nkro == last_keyboard_nkro)
+#endif
+    {
+        uint8_t i = 0;
+        for (; i < KEYBOARD_REPORT_SIZE; i++) {
+            if (report->raw[i] != last_keyboard_report.raw[i]) break;
+        }
+        if (i == KEYBOARD_REPORT_SIZE) {
+            keyboard_report_suppressed++;
+            return;
+        }
+    }
+    last_keyboard_report = *report;
+#ifdef NKRO_ENABLE
+    last_keyboard_nkro = keyboard_nkro;
+#endif
+
     (*driver->send_keyboard)(report);
+    trace(TRACE_KEYBOARD, report->raw[0], (uint16_t)report->raw[2]<<8 | report->raw[3]);
 
+#if DEBUG_MODULE_LEVEL >= DEBUG_LEVEL_VERBOSE
     if (debug_keyboard) {
         dprint("keyboard_report: ");
         for (uint8_t i = 0; i < KEYBOARD_REPORT_SIZE; i++) {
@@ -60,12 +92,14 @@ void host_keyboard_send(report_keyboard_t *report)
         }
         dprint("\n");
     }
+#endif
 }
 
 void host_mouse_send(report_mouse_t *report)
 {
     if (!driver) return;
     (*driver->send_mouse)(report);
+    trace(TRACE_MOUSE, report->buttons, (uint16_t)(uint8_t)report->x<<8 | (uint8_t)report->y);
 }
 
 void host_system_send(uint16_t report)
@@ -95,3 +129,26 @@ uint16_t host_last_consumer_report(void)
 {
     return last_consumer_report;
 }
+
+uint16_t host_keyboard_suppressed(void)
+{
+    return keyboard_report_suppressed;
+}
+
+uint8_t host_mouse_wheel_multiplier_v(void)
+{
+#ifdef MOUSE_WHEEL_HIRES
+    if (mouse_resolution_multiplier & MOUSE_RESOLUTION_V)
+        return MOUSE_WHEEL_MULTIPLIER;
+#endif
+    return 1;
+}
+
+uint8_t host_mouse_wheel_multiplier_h(void)
+{
+#ifdef MOUSE_WHEEL_HIRES
+    if (mouse_resolution_multiplier & MOUSE_RESOLUTION_H)
+        return MOUSE_WHEEL_MULTIPLIER;
+#endif
+    return 1;
+}
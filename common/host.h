@@ -32,6 +32,11 @@ extern "C" {
 extern bool keyboard_nkro;
 #endif
 
+#ifdef MOUSE_WHEEL_HIRES
+/* Resolution Multiplier feature report set by host */
+extern uint8_t mouse_resolution_multiplier;
+#endif
+
 extern uint8_t keyboard_idle;
 extern uint8_t keyboard_protocol;
 
@@ -49,6 +54,11 @@ void host_consumer_send(uint16_t data);
 
 uint16_t host_last_sysytem_report(void);
 uint16_t host_last_consumer_report(void);
+/* number of keyboard reports skipped as identical to the last one sent */
+uint16_t host_keyboard_suppressed(void);
+/* wheel units per detent host expects in mouse report */
+uint8_t host_mouse_wheel_multiplier_v(void);
+uint8_t host_mouse_wheel_multiplier_h(void);
 
 #ifdef __cplusplus
 }
@@ -30,6 +30,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "bootmagic.h"
 #include "eeconfig.h"
 #include "backlight.h"
+#include "action_macro.h"
+#include "trace.h"
 #ifdef MOUSEKEY_ENABLE
 #   include "mousekey.h"
 #endif
@@ -123,6 +125,14 @@ void keyboard_task(void)
 
 MATRIX_LOOP_END:
 
+#ifndef NO_ACTION_MACRO
+    // macro playing
+    action_macro_task();
+#endif
+
+    // trace log to console
+    trace_task();
+
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
     mousekey_task();
@@ -20,8 +20,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "timer.h"
 #include "print.h"
+#define DEBUG_MODULE    MOUSEKEY
 #include "debug.h"
+#include "progmem.h"
 #include "mousekey.h"
+#include "trace.h"
+#ifdef BOOTMAGIC_ENABLE
+#include "eeconfig.h"
+#endif
 
 
 
@@ -36,62 +42,173 @@ static void mousekey_debug(void);
  * Mouse keys  acceleration algorithm
  *  http://en.wikipedia.org/wiki/Mouse_keys
  *
- *  speed = delta * max_speed * (repeat / time_to_max)**((1000+curve)/1000)
+ *  speed = delta * max_speed * (time / time_to_max)**((100+curve)/100)
+ *
+ * Speed is in units per MOUSEKEY_INTERVAL and time is counted from the first
+ * repeated motion event in ms, so that mk_interval changes only how often
+ * reports are sent but not speed of pointer.
  */
 /* milliseconds between the initial key press and first repeated motion event (0-2550) */
 uint8_t mk_delay = MOUSEKEY_DELAY/10;
 /* milliseconds between repeated motion events (0-255) */
 uint8_t mk_interval = MOUSEKEY_INTERVAL;
-/* steady speed (in action_delta units) applied each event (0-255) */
+/* steady speed (in action_delta units) applied each MOUSEKEY_INTERVAL (0-255) */
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
-/* number of events (count) accelerating to steady speed (0-255) */
+/* time accelerating to steady speed in MOUSEKEY_INTERVAL (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
+/* ramp used to reach maximum pointer speed; linear at 0 (-100-100) */
+int8_t mk_curve = MOUSEKEY_CURVE;
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+/* wheel keeps moving after key release, longer with larger value; 0 to disable (0-8) */
+uint8_t mk_wheel_momentum = MOUSEKEY_WHEEL_MOMENTUM;
 
 
 static uint16_t last_timer = 0;
+/* time of the first repeated motion event */
+static uint16_t repeat_timer = 0;
+/* time up to which motion has been counted */
+static uint16_t step_timer = 0;
+/* direction of keys pressed: -1, 0 or 1 */
+static int8_t dir_x = 0, dir_y = 0, dir_v = 0, dir_h = 0;
+/* move below one unit carried to next event, in 1/256 unit */
+static uint8_t frac_x = 0, frac_y = 0, frac_v = 0, frac_h = 0;
+/* speed of wheel moving after key release, in 1/256 unit per MOUSEKEY_INTERVAL with sign */
+static int32_t glide_v = 0, glide_h = 0;
+
 
+/* log2(1 + i/16) in 1/4096 */
+static const uint16_t PROGMEM log2_table[17] = {
+    0, 358, 696, 1016, 1319, 1607, 1882, 2145,
+    2396, 2637, 2869, 3092, 3307, 3514, 3715, 3908, 4096
+};
+/* 2^(-i/16) in 1/65536 */
+static const uint16_t PROGMEM exp2_table[17] = {
+    65535, 62757, 60097, 57549, 55109, 52773, 50535, 48393,
+    46341, 44376, 42495, 40693, 38968, 37316, 35734, 34219, 32768
+};
 
-static uint8_t move_unit(void)
+/* speed kept after MOUSEKEY_INTERVAL in 1/256 for each mk_wheel_momentum,
+ * speed halves in 1, 2, 3, 4, 6, 8, 12 and 16 intervals */
+static const uint8_t PROGMEM momentum_table[8] = {
+    128, 181, 203, 215, 228, 235, 242, 245
+};
+
+/* (t / time)**((100+mk_curve)/100) in 1/256 */
+static uint16_t ramp(uint16_t t, uint16_t time)
 {
-    uint16_t unit;
-    if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/4;
-    } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_MOVE_DELTA;
-    } else if (mousekey_repeat >= mk_time_to_max) {
-        unit = MOUSEKEY_MOVE_DELTA * mk_max_speed;
-    } else {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed * mousekey_repeat) / mk_time_to_max;
+    if (t >= time) return 256;
+
+    uint16_t f = ((uint32_t)t << 8) / time;
+    if (f == 0 || mk_curve == 0) return f;
+
+    /* -log2(f/256) in 1/4096 */
+    uint8_t n = 0;
+    while (f < 128) { f <<= 1; n++; }
+    uint8_t i = (f - 128) >> 3;
+    uint8_t r = (f - 128) & 7;
+    uint16_t lo = pgm_read_word(&log2_table[i]);
+    uint16_t hi = pgm_read_word(&log2_table[i + 1]);
+    uint32_t l = ((uint32_t)(n + 1) << 12) - (lo + (((hi - lo) * r) >> 3));
+
+    /* 2^(-l * exponent) */
+    l = l * (100 + (mk_curve < -100 ? -100 : mk_curve)) / 100;
+    if (l >= (16UL << 12)) return 0;
+    i = (l >> 8) & 0x0F;
+    r = l & 0xFF;
+    lo = pgm_read_word(&exp2_table[i]);
+    hi = pgm_read_word(&exp2_table[i + 1]);
+    uint32_t e = lo - (((uint32_t)(lo - hi) * r) >> 8);
+    return ((e >> (l >> 12)) + 128) >> 8;
+}
+
+/* time from the first repeated motion event, kept from wrapping around */
+static uint16_t repeat_elapsed(void)
+{
+    uint16_t t = timer_elapsed(repeat_timer);
+    if (t > (uint16_t)UINT8_MAX * MOUSEKEY_INTERVAL) {
+        t = (uint16_t)UINT8_MAX * MOUSEKEY_INTERVAL;
+        repeat_timer = timer_read() - t;
     }
-    return (unit > MOUSEKEY_MOVE_MAX ? MOUSEKEY_MOVE_MAX : (unit == 0 ? 1 : unit));
+    return t;
 }
 
-static uint8_t wheel_unit(void)
+/* speed in 1/256 unit per MOUSEKEY_INTERVAL */
+static uint32_t accel_speed(uint8_t delta, uint8_t max_speed, uint8_t time_to_max)
 {
-    uint16_t unit;
+    uint32_t speed;
+    uint16_t unit = delta * max_speed;
     if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/4;
+        speed = (uint32_t)unit << 6;
     } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/2;
+        speed = (uint32_t)unit << 7;
     } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed);
+        speed = (uint32_t)unit << 8;
     } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_WHEEL_DELTA;
-    } else if (mousekey_repeat >= mk_wheel_time_to_max) {
-        unit = MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed;
+        speed = (uint32_t)delta << 8;
     } else {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed * mousekey_repeat) / mk_wheel_time_to_max;
+        speed = (uint32_t)unit * ramp(repeat_elapsed() + MOUSEKEY_INTERVAL, (uint16_t)time_to_max * MOUSEKEY_INTERVAL);
+    }
+    return (speed < 256 ? 256 : speed);
+}
+
+static uint32_t move_speed(void)
+{
+    return accel_speed(MOUSEKEY_MOVE_DELTA, mk_max_speed, mk_time_to_max);
+}
+
+/* in units host expects, 'multiplier' units per detent */
+static uint32_t wheel_speed(uint8_t multiplier)
+{
+    return accel_speed(MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, mk_wheel_time_to_max) * multiplier;
+}
+
+/* move in units for 'dt' ms at 'speed' including part carried in 'frac' */
+static uint16_t move_step(uint32_t speed, uint8_t dt, uint8_t *frac, uint16_t max)
+{
+    uint32_t d = (speed / MOUSEKEY_INTERVAL) * dt + (speed % MOUSEKEY_INTERVAL) * dt / MOUSEKEY_INTERVAL + *frac;
+    if ((d >> 8) >= max) {
+        *frac = 0;
+        return max;
+    }
+    *frac = d & 0xFF;
+    return d >> 8;
+}
+
+/* a * b / 65536 without overflow */
+static uint32_t mul_q16(uint32_t a, uint16_t b)
+{
+    return (a >> 16) * b + (((a & 0xFFFF) * b) >> 16);
+}
+
+/* wheel move of key released for 'dt' ms, then decays its speed */
+static int8_t glide_step(int32_t *glide, uint8_t dt, uint8_t *frac)
+{
+    uint32_t speed = (*glide < 0 ? -*glide : *glide);
+    int8_t d = move_step(speed, dt, frac, MOUSEKEY_WHEEL_MAX);
+
+    uint8_t m = (mk_wheel_momentum > 8 ? 8 : mk_wheel_momentum);
+    uint16_t loss = (uint16_t)(256 - pgm_read_byte(&momentum_table[m - 1])) * dt / MOUSEKEY_INTERVAL;
+    if (loss)
+        speed = (loss >= 256 ? 0 : mul_q16(speed, (256 - loss) << 8));
+    /* stop at a quarter unit per interval */
+    if (speed < 64) speed = 0;
+
+    if (*glide < 0) {
+        *glide = -(int32_t)speed;
+        return -d;
     }
-    return (unit > MOUSEKEY_WHEEL_MAX ? MOUSEKEY_WHEEL_MAX : (unit == 0 ? 1 : unit));
+    *glide = speed;
+    return d;
+}
+
+/* key release of wheel starts moving by momentum when it has accelerated */
+static int32_t glide_start(int8_t dir, uint8_t multiplier)
+{
+    if (!mk_wheel_momentum || !mousekey_repeat) return 0;
+    int32_t speed = wheel_speed(multiplier);
+    return (dir < 0 ? -speed : speed);
 }
 
 void mousekey_task(void)
@@ -99,42 +216,71 @@ void mousekey_task(void)
     if (timer_elapsed(last_timer) < (mousekey_repeat ? mk_interval : mk_delay*10))
         return;
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
+    if (!dir_x && !dir_y && !dir_v && !dir_h && !glide_v && !glide_h)
         return;
 
+    uint8_t dt = MOUSEKEY_INTERVAL;
+    if (mousekey_repeat == 0) {
+        repeat_timer = timer_read();
+    } else {
+        uint16_t elapsed = timer_elapsed(step_timer);
+        dt = (elapsed > UINT8_MAX ? UINT8_MAX : elapsed);
+    }
+    step_timer = timer_read();
+
     if (mousekey_repeat != UINT8_MAX)
         mousekey_repeat++;
 
 
-    if (mouse_report.x > 0) mouse_report.x = move_unit();
-    if (mouse_report.x < 0) mouse_report.x = move_unit() * -1;
-    if (mouse_report.y > 0) mouse_report.y = move_unit();
-    if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
+    uint32_t speed = move_speed();
+    /* diagonal move [1/sqrt(2) = 46341/65536] */
+    if (dir_x && dir_y)
+        speed = mul_q16(speed, 46341);
 
-    /* diagonal move [1/sqrt(2) = 0.7] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x *= 0.7;
-        mouse_report.y *= 0.7;
-    }
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    if (dir_x) mouse_report.x = move_step(speed, dt, &frac_x, MOUSEKEY_MOVE_MAX) * dir_x;
+    if (dir_y) mouse_report.y = move_step(speed, dt, &frac_y, MOUSEKEY_MOVE_MAX) * dir_y;
+
+    mouse_report.v = 0;
+    mouse_report.h = 0;
+    if (dir_v) mouse_report.v = move_step(wheel_speed(host_mouse_wheel_multiplier_v()), dt, &frac_v, MOUSEKEY_WHEEL_MAX) * dir_v;
+    else if (glide_v) mouse_report.v = glide_step(&glide_v, dt, &frac_v);
+    if (dir_h) mouse_report.h = move_step(wheel_speed(host_mouse_wheel_multiplier_h()), dt, &frac_h, MOUSEKEY_WHEEL_MAX) * dir_h;
+    else if (glide_h) mouse_report.h = glide_step(&glide_h, dt, &frac_h);
+
+    if (!dir_x && !dir_y && !dir_v && !dir_h && !glide_v && !glide_h)
+        mousekey_repeat = 0;
+
+    if (mouse_report.x || mouse_report.y || mouse_report.v || mouse_report.h)
+        mousekey_send();
+    else
+        last_timer = timer_read();
+}
 
-    if (mouse_report.v > 0) mouse_report.v = wheel_unit();
-    if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
-    if (mouse_report.h > 0) mouse_report.h = wheel_unit();
-    if (mouse_report.h < 0) mouse_report.h = wheel_unit() * -1;
+static int16_t move_on(int8_t *dir, int8_t d, uint8_t *frac)
+{
+    *dir = d;
+    return move_step(move_speed(), MOUSEKEY_INTERVAL, frac, MOUSEKEY_MOVE_MAX) * d;
+}
 
-    mousekey_send();
+static int8_t wheel_on(int8_t *dir, int8_t d, uint8_t *frac, uint8_t multiplier)
+{
+    *dir = d;
+    return move_step(wheel_speed(multiplier), MOUSEKEY_INTERVAL, frac, MOUSEKEY_WHEEL_MAX) * d;
 }
 
 void mousekey_on(uint8_t code)
 {
-    if      (code == KC_MS_UP)       mouse_report.y = move_unit() * -1;
-    else if (code == KC_MS_DOWN)     mouse_report.y = move_unit();
-    else if (code == KC_MS_LEFT)     mouse_report.x = move_unit() * -1;
-    else if (code == KC_MS_RIGHT)    mouse_report.x = move_unit();
-    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_unit();
-    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_unit() * -1;
-    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_unit() * -1;
-    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_unit();
+    trace(TRACE_MOUSEKEY, code, 1);
+    if      (code == KC_MS_UP)       mouse_report.y = move_on(&dir_y, -1, &frac_y);
+    else if (code == KC_MS_DOWN)     mouse_report.y = move_on(&dir_y,  1, &frac_y);
+    else if (code == KC_MS_LEFT)     mouse_report.x = move_on(&dir_x, -1, &frac_x);
+    else if (code == KC_MS_RIGHT)    mouse_report.x = move_on(&dir_x,  1, &frac_x);
+    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_on(&dir_v,  1, &frac_v, host_mouse_wheel_multiplier_v());
+    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_on(&dir_v, -1, &frac_v, host_mouse_wheel_multiplier_v());
+    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_on(&dir_h, -1, &frac_h, host_mouse_wheel_multiplier_h());
+    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_on(&dir_h,  1, &frac_h, host_mouse_wheel_multiplier_h());
     else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
     else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
     else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
@@ -147,14 +293,15 @@ void mousekey_on(uint8_t code)
 
 void mousekey_off(uint8_t code)
 {
-    if      (code == KC_MS_UP       && mouse_report.y < 0) mouse_report.y = 0;
-    else if (code == KC_MS_DOWN     && mouse_report.y > 0) mouse_report.y = 0;
-    else if (code == KC_MS_LEFT     && mouse_report.x < 0) mouse_report.x = 0;
-    else if (code == KC_MS_RIGHT    && mouse_report.x > 0) mouse_report.x = 0;
-    else if (code == KC_MS_WH_UP    && mouse_report.v > 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_DOWN  && mouse_report.v < 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_LEFT  && mouse_report.h < 0) mouse_report.h = 0;
-    else if (code == KC_MS_WH_RIGHT && mouse_report.h > 0) mouse_report.h = 0;
+    trace(TRACE_MOUSEKEY, code, 0);
+    if      (code == KC_MS_UP       && dir_y < 0) dir_y = 0;
+    else if (code == KC_MS_DOWN     && dir_y > 0) dir_y = 0;
+    else if (code == KC_MS_LEFT     && dir_x < 0) dir_x = 0;
+    else if (code == KC_MS_RIGHT    && dir_x > 0) dir_x = 0;
+    else if (code == KC_MS_WH_UP    && dir_v > 0) { glide_v = glide_start(dir_v, host_mouse_wheel_multiplier_v()); dir_v = 0; }
+    else if (code == KC_MS_WH_DOWN  && dir_v < 0) { glide_v = glide_start(dir_v, host_mouse_wheel_multiplier_v()); dir_v = 0; }
+    else if (code == KC_MS_WH_LEFT  && dir_h < 0) { glide_h = glide_start(dir_h, host_mouse_wheel_multiplier_h()); dir_h = 0; }
+    else if (code == KC_MS_WH_RIGHT && dir_h > 0) { glide_h = glide_start(dir_h, host_mouse_wheel_multiplier_h()); dir_h = 0; }
     else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
     else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
     else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
@@ -164,7 +311,21 @@ void mousekey_off(uint8_t code)
     else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
     else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
+    if (!dir_x) { mouse_report.x = 0; frac_x = 0; }
+    if (!dir_y) { mouse_report.y = 0; frac_y = 0; }
+    if (!dir_v) { mouse_report.v = 0; frac_v = 0; }
+    if (!dir_h) { mouse_report.h = 0; frac_h = 0; }
+    if (!dir_x && !dir_y && !dir_v && !dir_h && !glide_v && !glide_h)
+        mousekey_repeat = 0;
+}
+
+void mousekey_momentum_stop(void)
+{
+    if (!glide_v && !glide_h) return;
+    glide_v = glide_h = 0;
+    if (!dir_v) mouse_report.v = 0;
+    if (!dir_h) mouse_report.h = 0;
+    if (!dir_x && !dir_y && !dir_v && !dir_h)
         mousekey_repeat = 0;
 }
 
@@ -180,11 +341,51 @@ void mousekey_clear(void)
     mouse_report = (report_mouse_t){};
     mousekey_repeat = 0;
     mousekey_accel = 0;
+    dir_x = dir_y = dir_v = dir_h = 0;
+    frac_x = frac_y = frac_v = frac_h = 0;
+    glide_v = glide_h = 0;
+}
+
+#ifdef BOOTMAGIC_ENABLE
+#define MOUSEKEY_EECONFIG_VERSION   1
+
+void mousekey_load_params(void)
+{
+    uint8_t p[EECONFIG_MOUSEKEY_PARAMS_SIZE];
+    eeconfig_read_mousekey(p);
+    if (p[0] != MOUSEKEY_EECONFIG_VERSION) return;
+
+    mk_delay = p[1];
+    mk_interval = p[2];
+    mk_max_speed = p[3];
+    mk_time_to_max = p[4];
+    mk_curve = p[5];
+    mk_wheel_max_speed = p[6];
+    mk_wheel_time_to_max = p[7];
+    mk_wheel_momentum = p[8];
+}
+
+void mousekey_save_params(void)
+{
+    uint8_t p[EECONFIG_MOUSEKEY_PARAMS_SIZE] = {
+        MOUSEKEY_EECONFIG_VERSION,
+        mk_delay,
+        mk_interval,
+        mk_max_speed,
+        mk_time_to_max,
+        mk_curve,
+        mk_wheel_max_speed,
+        mk_wheel_time_to_max,
+        mk_wheel_momentum
+    };
+    eeconfig_write_mousekey(p);
 }
+#endif
 
 static void mousekey_debug(void)
 {
-    if (!debug_mouse) return;
+#if DEBUG_MODULE_LEVEL >= DEBUG_LEVEL_VERBOSE
+    if (!debug_mouse || !debug_module_enable) return;
     print("mousekey [btn|x y v h](rep/acl): [");
     phex(mouse_report.buttons); print("|");
     print_decs(mouse_report.x); print(" ");
@@ -193,4 +394,5 @@ static void mousekey_debug(void)
     print_decs(mouse_report.h); print("](");
     print_dec(mousekey_repeat); print("/");
     print_dec(mousekey_accel); print(")\n");
+#endif
 }
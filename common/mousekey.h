@@ -23,7 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 /* max value on report descriptor */
-#define MOUSEKEY_MOVE_MAX       127
+#define MOUSEKEY_MOVE_MAX       MOUSE_XY_MAX
 #define MOUSEKEY_WHEEL_MAX      127
 
 #ifndef MOUSEKEY_MOVE_DELTA
@@ -44,12 +44,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MOUSEKEY_TIME_TO_MAX
 #define MOUSEKEY_TIME_TO_MAX 20
 #endif
+#ifndef MOUSEKEY_CURVE
+#define MOUSEKEY_CURVE 0
+#endif
 #ifndef MOUSEKEY_WHEEL_MAX_SPEED
 #define MOUSEKEY_WHEEL_MAX_SPEED 8
 #endif
 #ifndef MOUSEKEY_WHEEL_TIME_TO_MAX
 #define MOUSEKEY_WHEEL_TIME_TO_MAX 40
 #endif
+#ifndef MOUSEKEY_WHEEL_MOMENTUM
+#define MOUSEKEY_WHEEL_MOMENTUM 0
+#endif
 
 
 #ifdef __cplusplus
@@ -60,8 +66,10 @@ extern uint8_t mk_delay;
 extern uint8_t mk_interval;
 extern uint8_t mk_max_speed;
 extern uint8_t mk_time_to_max;
+extern int8_t mk_curve;
 extern uint8_t mk_wheel_max_speed;
 extern uint8_t mk_wheel_time_to_max;
+extern uint8_t mk_wheel_momentum;
 
 
 void mousekey_task(void);
@@ -69,6 +77,12 @@ void mousekey_on(uint8_t code);
 void mousekey_off(uint8_t code);
 void mousekey_clear(void);
 void mousekey_send(void);
+/* stop wheel moving after key release */
+void mousekey_momentum_stop(void);
+#ifdef BOOTMAGIC_ENABLE
+void mousekey_load_params(void);
+void mousekey_save_params(void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,190 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "report.h"
+#include "util.h"
+
+
+/* Kinds of change between two keyboard reports, in the order host processes
+ * them within one report: modifier byte first, then released keys, then
+ * pressed keys. */
+#define CHANGE_MODS     (1<<0)
+#define CHANGE_RELEASE  (1<<1)
+#define CHANGE_PRESS    (1<<2)
+
+static bool has_key_byte(report_keyboard_t *report, uint8_t code)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == code)
+            return true;
+    }
+    return false;
+}
+
+static uint8_t report_keyboard_change(report_keyboard_t *from, report_keyboard_t *to, bool nkro, uint8_t *presses)
+{
+    uint8_t change = 0;
+
+    if (from->mods != to->mods)
+        change |= CHANGE_MODS;
+
+#ifdef NKRO_ENABLE
+    if (nkro) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            uint8_t on  = to->nkro.bits[i] & ~from->nkro.bits[i];
+            uint8_t off = from->nkro.bits[i] & ~to->nkro.bits[i];
+            if (on) {
+                change |= CHANGE_PRESS;
+                *presses += bitpop(on);
+            }
+            if (off)
+                change |= CHANGE_RELEASE;
+        }
+        return change;
+    }
+#endif
+
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        uint8_t code = to->keys[i];
+        if (code && !has_key_byte(from, code)) {
+            change |= CHANGE_PRESS;
+            (*presses)++;
+        }
+        code = from->keys[i];
+        if (code && !has_key_byte(to, code))
+            change |= CHANGE_RELEASE;
+    }
+    return change;
+}
+
+/* Whether report can replace queued one, which host gets after prev, without
+ * changing key sequence host sees.
+ * - no key or modifier changes in queued report and back again in report
+ * - changes of queued report are all processed by host before those of report
+ * - at most one key is pressed in total, host orders keys pressed in the same
+ *   report by their position in report */
+bool report_keyboard_mergeable(report_keyboard_t *prev, report_keyboard_t *queued, report_keyboard_t *report, bool nkro)
+{
+    if (queued->mods & ~prev->mods & ~report->mods)
+        return false;
+    if (prev->mods & ~queued->mods & report->mods)
+        return false;
+
+#ifdef NKRO_ENABLE
+    if (nkro) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            if (queued->nkro.bits[i] & ~prev->nkro.bits[i] & ~report->nkro.bits[i])
+                return false;
+            if (prev->nkro.bits[i] & ~queued->nkro.bits[i] & report->nkro.bits[i])
+                return false;
+        }
+    } else
+#endif
+    {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            uint8_t code = queued->keys[i];
+            if (code && !has_key_byte(prev, code) && !has_key_byte(report, code))
+                return false;
+
+            code = prev->keys[i];
+            if (code && !has_key_byte(queued, code) && has_key_byte(report, code))
+                return false;
+        }
+    }
+
+    uint8_t presses = 0;
+    uint8_t first = report_keyboard_change(prev, queued, nkro, &presses);
+    uint8_t second = report_keyboard_change(queued, report, nkro, &presses);
+    if (presses > 1)
+        return false;
+    if (first && second && (1<<biton(first)) > (second & -second))
+        return false;
+    return true;
+}
+
+
+static int8_t add_delta(int8_t a, int8_t b)
+{
+    int16_t d = (int16_t)a + b;
+    if (d > 127) return 127;
+    if (d < -127) return -127;
+    return d;
+}
+
+#ifdef MOUSE_EXTENDED_REPORT
+static int16_t add_delta_xy(int16_t a, int16_t b)
+{
+    int32_t d = (int32_t)a + b;
+    if (d > MOUSE_XY_MAX) return MOUSE_XY_MAX;
+    if (d < -MOUSE_XY_MAX) return -MOUSE_XY_MAX;
+    return d;
+}
+#else
+#define add_delta_xy add_delta
+#endif
+
+/* Adds motion of report to pending mouse report host has not got yet, with
+ * saturation. Returns false leaving pending as it is when pending already has
+ * button change from buttons host has got, as adding to it would move or hide
+ * the change. */
+static bool report_mouse_merge(report_mouse_t *pending, report_mouse_t *report, uint8_t buttons_sent)
+{
+    if (pending->buttons != buttons_sent)
+        return false;
+
+    pending->buttons = report->buttons;
+    pending->x = add_delta_xy(pending->x, report->x);
+    pending->y = add_delta_xy(pending->y, report->y);
+    pending->v = add_delta(pending->v, report->v);
+    pending->h = add_delta(pending->h, report->h);
+    return true;
+}
+
+/* Adds report to newest report of queue, or to second entry when first one
+ * has button change. Returns false when both entries have button change and
+ * queue is left as it is. */
+bool report_mouse_put(report_mouse_queue_t *queue, report_mouse_t *report)
+{
+    if (queue->count == 0) {
+        queue->report[0] = *report;
+        queue->count = 1;
+        return true;
+    }
+
+    uint8_t buttons = (queue->count == 1) ? queue->buttons_sent : queue->report[0].buttons;
+    if (report_mouse_merge(&queue->report[queue->count - 1], report, buttons))
+        return true;
+
+    if (queue->count == 1) {
+        queue->report[1] = *report;
+        queue->count = 2;
+        return true;
+    }
+    return false;
+}
+
+void report_mouse_sent(report_mouse_queue_t *queue)
+{
+    if (queue->count == 0)
+        return;
+
+    queue->buttons_sent = queue->report[0].buttons;
+    queue->report[0] = queue->report[1];
+    queue->count--;
+}
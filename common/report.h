@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define REPORT_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "keycode.h"
 
 
@@ -137,15 +138,60 @@ typedef struct {
 } __attribute__ ((packed)) report_keyboard_t;
 */
 
+/* X and Y of mouse report are 16-bit with MOUSE_EXTENDED_REPORT, 8-bit otherwise.
+ * -128 and -32768 are not used to keep range symmetric. */
+#ifdef MOUSE_EXTENDED_REPORT
+#   if defined(PROTOCOL_VUSB) || defined(PROTOCOL_BLUEFRUIT)
+#       error "MOUSE_EXTENDED_REPORT is supported only by LUFA and PJRC"
+#   endif
+typedef int16_t mouse_xy_report_t;
+#   define MOUSE_XY_MAX 32767
+#else
+typedef int8_t mouse_xy_report_t;
+#   define MOUSE_XY_MAX 127
+#endif
+
+/* Resolution Multiplier feature report of mouse with MOUSE_WHEEL_HIRES.
+ * Host sets 2-bit field of vertical or horizontal wheel to 1 to get
+ * MOUSE_WHEEL_MULTIPLIER units per wheel detent instead of one. */
+#ifdef MOUSE_WHEEL_HIRES
+#   ifndef MOUSE_WHEEL_MULTIPLIER
+#       define MOUSE_WHEEL_MULTIPLIER 8
+#   endif
+#   if MOUSE_WHEEL_MULTIPLIER < 2 || MOUSE_WHEEL_MULTIPLIER > 127
+#       error "MOUSE_WHEEL_MULTIPLIER must be 2-127"
+#   endif
+#endif
+#define MOUSE_RESOLUTION_V  (3<<0)
+#define MOUSE_RESOLUTION_H  (3<<2)
+
 typedef struct {
     uint8_t buttons;
-    int8_t x;
-    int8_t y;
+    mouse_xy_report_t x;
+    mouse_xy_report_t y;
     int8_t v;
     int8_t h;
 } __attribute__ ((packed)) report_mouse_t;
 
 
+/* whether queued keyboard report can be replaced with report without changing key sequence host sees */
+bool report_keyboard_mergeable(report_keyboard_t *prev, report_keyboard_t *queued, report_keyboard_t *report, bool nkro);
+
+/* Mouse reports host has not got yet. report[0] is sent first and report[1]
+ * takes reports after button change of report[0], so that motion is added up
+ * while endpoint is busy and no button change is lost. */
+typedef struct {
+    report_mouse_t report[2];
+    uint8_t count;
+    uint8_t buttons_sent;   // buttons of last report host has got
+} report_mouse_queue_t;
+
+/* add report to mouse queue, false when both reports have button change */
+bool report_mouse_put(report_mouse_queue_t *queue, report_mouse_t *report);
+/* remove report[0] after endpoint accepted it */
+void report_mouse_sent(report_mouse_queue_t *queue);
+
+
 /* keycode to system usage */
 #define KEYCODE2SYSTEM(key) \
     (key == KC_SYSTEM_POWER ? SYSTEM_POWER_DOWN : \
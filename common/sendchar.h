@@ -27,6 +27,8 @@ extern "C" {
 
 /* transmit a character.  return 0 on success, -1 on error. */
 int8_t sendchar(uint8_t c);
+/* number of characters sendchar takes now without waiting or dropping */
+uint8_t sendchar_free(void);
 
 #ifdef __cplusplus
 }
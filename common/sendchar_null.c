@@ -21,3 +21,8 @@ int8_t sendchar(uint8_t c)
 {
     return 0;
 }
+
+uint8_t sendchar_free(void)
+{
+    return UINT8_MAX;
+}
@@ -23,3 +23,9 @@ int8_t sendchar(uint8_t c)
     uart_putchar(c);
     return 0;
 }
+
+/* uart_putchar waits for room */
+uint8_t sendchar_free(void)
+{
+    return UINT8_MAX;
+}
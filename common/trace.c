@@ -0,0 +1,133 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "timer.h"
+#include "print.h"
+#include "sendchar.h"
+#include "trace.h"
+
+#ifdef NO_PRINT
+#error "TRACE_ENABLE needs print, remove NO_PRINT."
+#endif
+
+
+/* records in buffer, 6 bytes each */
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE   32
+#endif
+#if TRACE_BUFFER_SIZE > 128
+#error "TRACE_BUFFER_SIZE must be 128 or less."
+#endif
+
+/* records sent to console per trace_task */
+#ifndef TRACE_DRAIN
+#define TRACE_DRAIN         2
+#endif
+
+/* "~TTTTIIAABBBB\n" */
+#define TRACE_LINE_LEN      14
+
+typedef struct {
+    uint16_t time;
+    uint8_t  id;
+    uint8_t  a;
+    uint16_t b;
+} trace_record_t;
+
+static trace_record_t trace_buf[TRACE_BUFFER_SIZE];
+static volatile uint8_t trace_head = 0;
+static volatile uint8_t trace_count = 0;
+static volatile uint16_t trace_dropped = 0;
+
+
+static void put_buf(uint16_t time, uint8_t id, uint8_t a, uint16_t b)
+{
+    uint8_t i = trace_head + trace_count;
+    if (i >= TRACE_BUFFER_SIZE) i -= TRACE_BUFFER_SIZE;
+    trace_buf[i] = (trace_record_t){ .time = time, .id = id, .a = a, .b = b };
+    trace_count++;
+}
+
+/* Can be called from interrupt as well. */
+void trace(uint8_t id, uint8_t a, uint16_t b)
+{
+    uint16_t time = timer_read();
+
+    uint8_t sreg = SREG;
+    cli();
+    /* records lost come before this one */
+    if (trace_dropped && trace_count < TRACE_BUFFER_SIZE - 1) {
+        put_buf(time, TRACE_DROP, 0, trace_dropped);
+        trace_dropped = 0;
+    }
+    if (!trace_dropped && trace_count < TRACE_BUFFER_SIZE) {
+        put_buf(time, id, a, b);
+    } else {
+        trace_dropped++;
+    }
+    SREG = sreg;
+}
+
+static void put_hex8(uint8_t v)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    xputc(hex[v>>4]);
+    xputc(hex[v & 0xF]);
+}
+
+static void put_record(trace_record_t *r)
+{
+    xputc('~');
+    put_hex8(r->time>>8);
+    put_hex8(r->time);
+    put_hex8(r->id);
+    put_hex8(r->a);
+    put_hex8(r->b>>8);
+    put_hex8(r->b);
+    xputc('\n');
+}
+
+void trace_task(void)
+{
+    trace_record_t r;
+
+    for (uint8_t n = 0; n < TRACE_DRAIN; n++) {
+        /* record stays in buffer until console takes whole line, output
+         * dropped by console would garble the line and not be counted */
+        if (sendchar_free() < TRACE_LINE_LEN) return;
+
+        uint8_t sreg = SREG;
+        cli();
+        if (trace_count) {
+            r = trace_buf[trace_head];
+            if (++trace_head == TRACE_BUFFER_SIZE) trace_head = 0;
+            trace_count--;
+        } else if (trace_dropped) {
+            /* records lost after all in buffer */
+            r = (trace_record_t){ .time = timer_read(), .id = TRACE_DROP, .b = trace_dropped };
+            trace_dropped = 0;
+        } else {
+            SREG = sreg;
+            return;
+        }
+        SREG = sreg;
+
+        put_record(&r);
+    }
+}
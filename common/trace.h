@@ -0,0 +1,72 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+
+/*
+ * Binary trace log
+ *
+ * trace() stores event id and raw arguments with time into RAM ring buffer,
+ * nothing is formatted on the spot. trace_task() drains records to console
+ * in background, each when console has room for its whole line, as lines of
+ * hex digits:
+ *
+ *     ~TTTTIIAABBBB
+ *     TTTT: timer_read() when traced
+ *     II:   event id
+ *     AA:   argument a(8bit)
+ *     BBBB: argument b(16bit)
+ *
+ * tool/trace_decode formats them to text, this list is shared with it.
+ *
+ *  id                      name                a           b
+ */
+#define TRACE_EVENTS(X) \
+    X(TRACE_DROP,           "drop",             "-",        "records lost") \
+    X(TRACE_KEY_EVENT,      "key_event",        "pressed",  "row<<8|col") \
+    X(TRACE_ACTION,         "action",           "pressed",  "action code") \
+    X(TRACE_TAPPING_KEY,    "tapping_key",      "int|pressed|count", "row<<8|col") \
+    X(TRACE_WAITING_ENQ,    "waiting_enq",      "index",    "row<<8|col") \
+    X(TRACE_KEYBOARD,       "keyboard_report",  "mods",     "raw[2]<<8|raw[3]") \
+    X(TRACE_MOUSE,          "mouse_report",     "buttons",  "x<<8|y") \
+    X(TRACE_MOUSEKEY,       "mousekey",         "keycode",  "on")
+
+enum trace_id {
+#define TRACE_ID(id, name, a, b)    id,
+    TRACE_EVENTS(TRACE_ID)
+#undef TRACE_ID
+};
+
+/* bits of TRACE_TAPPING_KEY argument a, tap count in low nibble */
+#define TRACE_TAP_INTERRUPTED   (1<<7)
+#define TRACE_TAP_PRESSED       (1<<6)
+
+#define TRACE_KEY(key)  ((uint16_t)(key).row<<8 | (key).col)
+
+
+#ifdef TRACE_ENABLE
+void trace(uint8_t id, uint8_t a, uint16_t b);
+void trace_task(void);
+#else
+#define trace(id, a, b)
+#define trace_task()
+#endif
+
+#endif
@@ -51,6 +51,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define ADB_DATA_BIT    0
 //#define ADB_PSW_BIT     1       // optional
 
+/* poll interval(ms): shortest while keyboard sends keys, doubled up to longest while idle
+ * shorter than 12ms can overload poor keyboard controller, lower it only when yours keeps up */
+//#define ADB_POLL_INTERVAL_MIN   12
+//#define ADB_POLL_INTERVAL_MAX   12
+/* polls in a row answering SRQ without key data */
+//#define ADB_SRQ_POLL_MAX        8
+
 /* key combination for command */
 #ifndef __ASSEMBLER__
 #include "adb.h"
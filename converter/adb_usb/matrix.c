@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "util.h"
 #include "debug.h"
+#include "timer.h"
 #include "adb.h"
 #include "matrix.h"
 
@@ -36,6 +37,28 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   error "MATRIX_ROWS must not exceed 255"
 #endif
 
+/*
+ * Keyboard is polled at shortest interval while it sends keys, and the
+ * interval is doubled up to longest each time it has nothing to send. Poor
+ * ADB keyboard controller misses strokes when it is polled in a row without
+ * interval, so shortest is the 12ms recommended in protocol/adb.c unless
+ * config.h lowers it for controller known to keep up.
+ *
+ * Service request(SRQ) is answered with a poll on next scan without the
+ * interval. Error of polling doesn't shorten the interval, and SRQ without
+ * key data is answered only for ADB_SRQ_POLL_MAX polls in a row, since SRQ
+ * can come from other device this converter doesn't poll.
+ */
+#ifndef ADB_POLL_INTERVAL_MIN
+#define ADB_POLL_INTERVAL_MIN   12  // ms
+#endif
+#ifndef ADB_POLL_INTERVAL_MAX
+#define ADB_POLL_INTERVAL_MAX   12  // ms
+#endif
+#ifndef ADB_SRQ_POLL_MAX
+#define ADB_SRQ_POLL_MAX        8
+#endif
+
 
 static bool is_modified = false;
 
@@ -95,6 +118,10 @@ uint8_t matrix_scan(void)
     dozens of code variations and it kept generating broken assembly output. So
     beware if attempting to make extra_key code more logical and efficient. */
     static volatile uint16_t extra_key = 0xFFFF;
+    static uint16_t poll_time = 0;
+    static uint8_t poll_interval = ADB_POLL_INTERVAL_MAX;
+    static uint8_t srq_polls = 0;
+    static bool srq_poll_now = false;
     uint16_t codes;
     uint8_t key0, key1;
 
@@ -105,8 +132,29 @@ uint8_t matrix_scan(void)
 
     if ( codes == 0xFFFF )
     {
-        _delay_ms(12);  // delay for preventing overload of poor ADB keyboard controller
+        // interval for preventing overload of poor ADB keyboard controller
+        if (!srq_poll_now && timer_elapsed(poll_time) < poll_interval) {
+            return 0;
+        }
+        srq_poll_now = false;
         codes = adb_host_kbd_recv();
+        poll_time = timer_read();
+
+        // error is 0xFFxx except for 0xFFFF(power key release)
+        if (codes && ((codes>>8) != 0xFF || codes == 0xFFFF)) {
+            poll_interval = ADB_POLL_INTERVAL_MIN;
+            srq_polls = 0;
+        } else if (adb_host_srq() && srq_polls < ADB_SRQ_POLL_MAX) {
+            poll_interval = ADB_POLL_INTERVAL_MIN;
+            srq_poll_now = true;
+            srq_polls++;
+        } else {
+            if (!adb_host_srq()) srq_polls = 0;
+            if (poll_interval < ADB_POLL_INTERVAL_MAX) {
+                poll_interval *= 2;
+                if (poll_interval > ADB_POLL_INTERVAL_MAX) poll_interval = ADB_POLL_INTERVAL_MAX;
+            }
+        }
     }
     key0 = codes>>8;
     key1 = codes&0xFF;
@@ -0,0 +1,46 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "keycode.h"
+#include "print.h"
+#include "command.h"
+#include "ps2.h"
+#include "ps2_kbd.h"
+
+bool command_extra(uint8_t code)
+{
+    switch (code) {
+        case KC_H:
+        case KC_SLASH: /* ? */
+            print("\n\n----- PS/2 converter Help -----\n");
+            print("P:	PS/2 error counts\n");
+            return false;
+        case KC_P:
+            print("\n\n----- PS/2 -----\n");
+            print_val_dec(ps2_kbd_code_set());
+            print_val_dec(ps2_error_count.parity);
+            print_val_dec(ps2_error_count.frame);
+            print_val_dec(ps2_error_count.timeout);
+            print_val_dec(ps2_error_count.overflow);
+            print_val_dec(ps2_error_count.resend);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
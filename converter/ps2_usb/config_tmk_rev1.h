@@ -42,6 +42,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 //#define NO_SUSPEND_POWER_DOWN
 
+/* use Scan Code Set 2 even if keyboard supports Set 3 */
+//#define PS2_KBD_SET2_ONLY
+
 
 /*
  * PS/2 Busywait
@@ -99,7 +102,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 } while (0)
 #define PS2_USART_RX_READY      (UCSR1A & (1<<RXC1))
 #define PS2_USART_RX_DATA       UDR1
-#define PS2_USART_ERROR         (UCSR1A & ((1<<FE1) | (1<<DOR1) | (1<<UPE1)))
+#define PS2_USART_ERROR         (UCSR1A & (PS2_USART_ERROR_FRAME | PS2_USART_ERROR_OVERRUN | PS2_USART_ERROR_PARITY))
+#define PS2_USART_ERROR_FRAME   (1<<FE1)
+#define PS2_USART_ERROR_OVERRUN (1<<DOR1)
+#define PS2_USART_ERROR_PARITY  (1<<UPE1)
 #define PS2_USART_RX_VECT       USART1_RX_vect
 #elif defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega328P__)
 /* XCK for clock line and RXD for data line */
@@ -139,7 +145,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 } while (0)
 #define PS2_USART_RX_READY      (UCSR0A & (1<<RXC0))
 #define PS2_USART_RX_DATA       UDR0
-#define PS2_USART_ERROR         (UCSR0A & ((1<<FE0) | (1<<DOR0) | (1<<UPE0)))
+#define PS2_USART_ERROR         (UCSR0A & (PS2_USART_ERROR_FRAME | PS2_USART_ERROR_OVERRUN | PS2_USART_ERROR_PARITY))
+#define PS2_USART_ERROR_FRAME   (1<<FE0)
+#define PS2_USART_ERROR_OVERRUN (1<<DOR0)
+#define PS2_USART_ERROR_PARITY  (1<<UPE0)
 #define PS2_USART_RX_VECT       USART_RX_vect
 #endif
 #endif
@@ -41,6 +41,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 //#define NO_SUSPEND_POWER_DOWN
 
+/* use Scan Code Set 2 even if keyboard supports Set 3 */
+//#define PS2_KBD_SET2_ONLY
+
 
 /*
  * PS/2 Busywait
@@ -21,7 +21,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "util.h"
 #include "debug.h"
+#include "timer.h"
 #include "ps2.h"
+#include "ps2_kbd.h"
 #include "matrix.h"
 
 
@@ -62,9 +64,9 @@ static uint8_t matrix[MATRIX_ROWS];
 #define COL(code)      (code&0x07)
 
 // matrix positions for exceptional keys
-#define F7             (0x83)
-#define PRINT_SCREEN   (0xFC)
-#define PAUSE          (0xFE)
+#define F7             PS2_KBD_F7
+#define PRINT_SCREEN   PS2_KBD_PRINT_SCREEN
+#define PAUSE          PS2_KBD_PAUSE
 
 static bool is_modified = false;
 
@@ -92,6 +94,33 @@ void matrix_init(void)
     return;
 }
 
+/*
+ * Scan Code Set 3 is used when keyboard supports it, with make and break for
+ * all keys(F8). Set 3 codes are translated into Set 2 positions, keymaps are
+ * common to both sets. Keyboard which refuses Set 3 is left in Set 2.
+ * Keyboard starts in Set 2 after BAT, the set is selected again then.
+ */
+static void select_code_set(void)
+{
+#ifndef PS2_KBD_SET2_ONLY
+    // reported as 3F when translation of 8042 is on
+    uint8_t set;
+    if (ps2_host_send(0xF0) == PS2_ACK && ps2_host_send(0x03) == PS2_ACK &&
+        ps2_host_send(0xF0) == PS2_ACK && ps2_host_send(0x00) == PS2_ACK &&
+        ((set = ps2_host_recv_response()) == 0x03 || set == 0x3F) &&
+        ps2_host_send(0xF8) == PS2_ACK) {
+        ps2_kbd_set_code_set(3);
+        print("Scan Code Set 3\n");
+        return;
+    }
+    // keyboard may have taken Set 3 partly
+    ps2_host_send(0xF0);
+    ps2_host_send(0x02);
+#endif
+    ps2_kbd_set_code_set(2);
+    print("Scan Code Set 2\n");
+}
+
 /*
  * PS/2 Scan Code Set 2: Exceptional Handling
  *
@@ -154,239 +183,52 @@ void matrix_init(void)
  *               And we need a ad hoc 'pseudo break code' hack to get the key off
  *               because it has no break code.
  *
+ * Scan codes are decoded in protocol/ps2_kbd.c on receive and matrix_scan
+ * applies key events queued.
  */
 uint8_t matrix_scan(void)
 {
+    is_modified = false;
 
-    // scan code reading states
-    static enum {
-        INIT,
-        F0,
-        E0,
-        E0_F0,
-        // Pause
-        E1,
-        E1_14,
-        E1_14_77,
-        E1_14_77_E1,
-        E1_14_77_E1_F0,
-        E1_14_77_E1_F0_14,
-        E1_14_77_E1_F0_14_F0,
-        // Control'd Pause
-        E0_7E,
-        E0_7E_E0,
-        E0_7E_E0_F0,
-    } state = INIT;
-
+    // keys changed in this scan, later event of these is left for next scan
+    uint8_t changed[MATRIX_ROWS] = { 0 };
 
-    is_modified = false;
+    if (!ps2_kbd_code_set()) {
+        select_code_set();
+    }
 
-    // 'pseudo break code' hack
-    if (matrix_is_on(ROW(PAUSE), COL(PAUSE))) {
+    // 'pseudo break code' hack, Pause has break code in Set 3
+    if (ps2_kbd_code_set() == 2 && matrix_is_on(ROW(PAUSE), COL(PAUSE))) {
         matrix_break(PAUSE);
+        changed[ROW(PAUSE)] |= 1<<COL(PAUSE);
     }
 
-    uint8_t code = ps2_host_recv();
-    if (code) xprintf("%i\r\n", code);
-    if (!ps2_error) {
-        switch (state) {
-            case INIT:
-                switch (code) {
-                    case 0xE0:
-                        state = E0;
-                        break;
-                    case 0xF0:
-                        state = F0;
-                        break;
-                    case 0xE1:
-                        state = E1;
-                        break;
-                    case 0x83:  // F7
-                        matrix_make(F7);
-                        state = INIT;
-                        break;
-                    case 0x84:  // Alt'd PrintScreen
-                        matrix_make(PRINT_SCREEN);
-                        state = INIT;
-                        break;
-                    case 0x00:  // Overrun [3]p.25
-                        matrix_clear();
-                        clear_keyboard();
-                        print("Overrun\n");
-                        state = INIT;
-                        break;
-                    default:    // normal key make
-                        if (code < 0x80) {
-                            matrix_make(code);
-                        } else {
-                            matrix_clear();
-                            clear_keyboard();
-                            xprintf("unexpected scan code at INIT: %02X\n", code);
-                        }
-                        state = INIT;
-                }
-                break;
-            case E0:    // E0-Prefixed
-                switch (code) {
-                    case 0x12:  // to be ignored
-                    case 0x59:  // to be ignored
-                        state = INIT;
-                        break;
-                    case 0x7E:  // Control'd Pause
-                        state = E0_7E;
-                        break;
-                    case 0xF0:
-                        state = E0_F0;
-                        break;
-                    default:
-                        if (code < 0x80) {
-                            matrix_make(code|0x80);
-                        } else {
-                            matrix_clear();
-                            clear_keyboard();
-                            xprintf("unexpected scan code at E0: %02X\n", code);
-                        }
-                        state = INIT;
-                }
-                break;
-            case F0:    // Break code
-                switch (code) {
-                    case 0x83:  // F7
-                        matrix_break(F7);
-                        state = INIT;
-                        break;
-                    case 0x84:  // Alt'd PrintScreen
-                        matrix_break(PRINT_SCREEN);
-                        state = INIT;
-                        break;
-                    case 0xF0:
-                        matrix_clear();
-                        clear_keyboard();
-                        xprintf("unexpected scan code at F0: F0(clear and cont.)\n");
-                        break;
-                    default:
-                    if (code < 0x80) {
-                        matrix_break(code);
-                    } else {
-                        matrix_clear();
-                        clear_keyboard();
-                        xprintf("unexpected scan code at F0: %02X\n", code);
-                    }
-                    state = INIT;
-                }
-                break;
-            case E0_F0: // Break code of E0-prefixed
-                switch (code) {
-                    case 0x12:  // to be ignored
-                    case 0x59:  // to be ignored
-                        state = INIT;
-                        break;
-                    default:
-                        if (code < 0x80) {
-                            matrix_break(code|0x80);
-                        } else {
-                            matrix_clear();
-                            clear_keyboard();
-                            xprintf("unexpected scan code at E0_F0: %02X\n", code);
-                        }
-                        state = INIT;
-                }
-                break;
-            // following are states of Pause
-            case E1:
-                switch (code) {
-                    case 0x14:
-                        state = E1_14;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14:
-                switch (code) {
-                    case 0x77:
-                        state = E1_14_77;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77:
-                switch (code) {
-                    case 0xE1:
-                        state = E1_14_77_E1;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1:
-                switch (code) {
-                    case 0xF0:
-                        state = E1_14_77_E1_F0;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1_F0:
-                switch (code) {
-                    case 0x14:
-                        state = E1_14_77_E1_F0_14;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1_F0_14:
-                switch (code) {
-                    case 0xF0:
-                        state = E1_14_77_E1_F0_14_F0;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1_F0_14_F0:
-                switch (code) {
-                    case 0x77:
-                        matrix_make(PAUSE);
-                        state = INIT;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            // Following are states of Control'd Pause
-            case E0_7E:
-                if (code == 0xE0)
-                    state = E0_7E_E0;
-                else
-                    state = INIT;
-                break;
-            case E0_7E_E0:
-                if (code == 0xF0)
-                    state = E0_7E_E0_F0;
-                else
-                    state = INIT;
-                break;
-            case E0_7E_E0_F0:
-                if (code == 0x7E)
-                    matrix_make(PAUSE);
-                state = INIT;
-                break;
-            default:
-                state = INIT;
+    ps2_kbd_task();
+
+    // apply all events decoded so far at once
+    ps2_kbd_event_t event;
+    while (ps2_kbd_event_peek(&event)) {
+        if (event.code == PS2_KBD_CLEAR) {
+            if (is_modified) break;
+            matrix_clear();
+            clear_keyboard();
+            ps2_kbd_event_remove();
+            break;
         }
-    }
+        if (changed[ROW(event.code)] & (1<<COL(event.code))) break;
+        changed[ROW(event.code)] |= 1<<COL(event.code);
+        ps2_kbd_event_remove();
 
-    // TODO: request RESEND when error occurs?
-/*
-    if (PS2_IS_FAILED(ps2_error)) {
-        uint8_t ret = ps2_host_send(PS2_RESEND);
-        xprintf("Resend: %02X\n", ret);
+        if (debug_matrix) {
+            xprintf("%02X %s %ums\n", event.code, (event.make ? "make" : "break"),
+                    timer_elapsed(event.time));
+        }
+        if (event.make) {
+            matrix_make(event.code);
+        } else {
+            matrix_break(event.code);
+        }
     }
-*/
     return 1;
 }
 
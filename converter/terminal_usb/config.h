@@ -86,7 +86,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 } while (0)
 #define PS2_USART_RX_READY      (UCSR1A & (1<<RXC1))
 #define PS2_USART_RX_DATA       UDR1
-#define PS2_USART_ERROR         (UCSR1A & ((1<<FE1) | (1<<DOR1) | (1<<UPE1)))
+#define PS2_USART_ERROR         (UCSR1A & (PS2_USART_ERROR_FRAME | PS2_USART_ERROR_OVERRUN | PS2_USART_ERROR_PARITY))
+#define PS2_USART_ERROR_FRAME   (1<<FE1)
+#define PS2_USART_ERROR_OVERRUN (1<<DOR1)
+#define PS2_USART_ERROR_PARITY  (1<<UPE1)
 #define PS2_USART_RX_VECT       USART1_RX_vect
 #endif
 
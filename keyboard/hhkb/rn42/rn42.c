@@ -7,6 +7,10 @@
 #include "timer.h"
 #include "wait.h"
 
+#ifdef MOUSE_EXTENDED_REPORT
+#   error "MOUSE_EXTENDED_REPORT is not supported by RN-42 raw report"
+#endif
+
 
 /* Host driver */
 static uint8_t keyboard_leds(void);
@@ -68,6 +68,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //#define NO_ACTION_FUNCTION
 
 
+/* PS/2 mouse runs in stream mode with PS2_USE_INT and PS2_USE_USART, polls in remote mode with this */
+//#define PS2_MOUSE_USE_REMOTE_MODE
+//#define PS2_MOUSE_SAMPLE_RATE   200
+
 /* PS/2 mouse */
 #ifdef PS2_USE_BUSYWAIT
 #   define PS2_CLOCK_PORT  PORTD
@@ -148,7 +152,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 } while (0)
 #define PS2_USART_RX_READY      (UCSR1A & (1<<RXC1))
 #define PS2_USART_RX_DATA       UDR1
-#define PS2_USART_ERROR         (UCSR1A & ((1<<FE1) | (1<<DOR1) | (1<<UPE1)))
+#define PS2_USART_ERROR         (UCSR1A & (PS2_USART_ERROR_FRAME | PS2_USART_ERROR_OVERRUN | PS2_USART_ERROR_PARITY))
+#define PS2_USART_ERROR_FRAME   (1<<FE1)
+#define PS2_USART_ERROR_OVERRUN (1<<DOR1)
+#define PS2_USART_ERROR_PARITY  (1<<UPE1)
 #define PS2_USART_RX_VECT       USART1_RX_vect
 #endif
 #endif
@@ -7,6 +7,11 @@ ifdef PS2_MOUSE_ENABLE
     OPT_DEFS += -DMOUSE_ENABLE
 endif
 
+ifdef PS2_KBD_ENABLE
+    SRC += protocol/ps2_kbd.c
+    OPT_DEFS += -DPS2_KBD_ENABLE
+endif
+
 ifdef PS2_USE_BUSYWAIT
     SRC += protocol/ps2_busywait.c
     SRC += protocol/ps2_io_avr.c
@@ -61,6 +61,8 @@ static inline void send_byte(uint8_t data);
 static inline uint16_t wait_data_lo(uint16_t us);
 static inline uint16_t wait_data_hi(uint16_t us);
 
+static bool srq = false;
+
 
 void adb_host_init(void)
 {
@@ -78,9 +80,15 @@ bool adb_host_psw(void)
 }
 #endif
 
+bool adb_host_srq(void)
+{
+    return srq;
+}
+
 /*
  * Don't call this in a row without the delay, otherwise it makes some of poor controllers
- * overloaded and misses strokes. Recommended interval is 12ms.
+ * overloaded and misses strokes. Recommended interval is 12ms, which is default of
+ * ADB_POLL_INTERVAL_MIN in converter/adb_usb.
  *
  * Thanks a lot, blargg!
  * <http://geekhack.org/index.php?topic=14290.msg1068919#msg1068919>
@@ -128,7 +136,8 @@ uint16_t adb_host_kbd_recv(void)
     attention();
     send_byte(0x2C);            // Addr:Keyboard(0010), Cmd:Talk(11), Register0(00)
     place_bit0();               // Stopbit(0)
-    if (!wait_data_hi(500)) {    // Service Request(310us Adjustable Keyboard): just ignored
+    srq = !data_in();           // Service Request: device with data holds stop bit low(300us)
+    if (!wait_data_hi(500)) {    // Service Request(310us Adjustable Keyboard)
         sei();
         return -30;             // something wrong
     }
@@ -408,6 +417,7 @@ Communication
     Service request from device(Srq):
     Device can request to send at commad(Global only?) stop bit.
     Requesting device keeps low for 140-260us at stop bit of command.
+    Host can see it as low line still 35us after releasing stop bit.
 
 
 Keyboard Data(Register0)
@@ -34,6 +34,11 @@ VPATH += $(TOP_DIR)/$(LUFA_PATH)
 #ifdef EXTRAKEY_ENABLE
 #endif
 
+# Send keyboard report at Start-of-Frame instead of writing endpoint directly
+ifdef KEYBOARD_SOF_SYNC_ENABLE
+    OPT_DEFS += -DKEYBOARD_SOF_SYNC_ENABLE
+endif
+
 # LUFA library compile-time options and predefined tokens
 LUFA_OPTS  = -DUSB_DEVICE_ONLY
 LUFA_OPTS += -DUSE_FLASH_DESCRIPTORS
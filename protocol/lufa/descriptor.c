@@ -107,12 +107,64 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM MouseReport[] =
             HID_RI_USAGE_PAGE(8, 0x01), /* Generic Desktop */
             HID_RI_USAGE(8, 0x30), /* Usage X */
             HID_RI_USAGE(8, 0x31), /* Usage Y */
+#ifdef MOUSE_EXTENDED_REPORT
+            HID_RI_LOGICAL_MINIMUM(16, -32767),
+            HID_RI_LOGICAL_MAXIMUM(16, 32767),
+            HID_RI_REPORT_COUNT(8, 0x02),
+            HID_RI_REPORT_SIZE(8, 0x10),
+#else
             HID_RI_LOGICAL_MINIMUM(8, -127),
             HID_RI_LOGICAL_MAXIMUM(8, 127),
             HID_RI_REPORT_COUNT(8, 0x02),
             HID_RI_REPORT_SIZE(8, 0x08),
+#endif
             HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE),
 
+#ifdef MOUSE_WHEEL_HIRES
+            /* Resolution Multiplier applies to wheel in the same logical collection */
+            HID_RI_COLLECTION(8, 0x02), /* Logical */
+                HID_RI_USAGE(8, 0x48), /* Resolution Multiplier */
+                HID_RI_LOGICAL_MINIMUM(8, 0),
+                HID_RI_LOGICAL_MAXIMUM(8, 1),
+                HID_RI_PHYSICAL_MINIMUM(8, 1),
+                HID_RI_PHYSICAL_MAXIMUM(8, MOUSE_WHEEL_MULTIPLIER),
+                HID_RI_REPORT_COUNT(8, 0x01),
+                HID_RI_REPORT_SIZE(8, 0x02),
+                HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+                HID_RI_USAGE(8, 0x38), /* Wheel */
+                HID_RI_LOGICAL_MINIMUM(8, -127),
+                HID_RI_LOGICAL_MAXIMUM(8, 127),
+                HID_RI_PHYSICAL_MINIMUM(8, 0), /* reset physical */
+                HID_RI_PHYSICAL_MAXIMUM(8, 0),
+                HID_RI_REPORT_COUNT(8, 0x01),
+                HID_RI_REPORT_SIZE(8, 0x08),
+                HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE),
+            HID_RI_END_COLLECTION(0),
+
+            HID_RI_COLLECTION(8, 0x02), /* Logical */
+                HID_RI_USAGE(8, 0x48), /* Resolution Multiplier */
+                HID_RI_LOGICAL_MINIMUM(8, 0),
+                HID_RI_LOGICAL_MAXIMUM(8, 1),
+                HID_RI_PHYSICAL_MINIMUM(8, 1),
+                HID_RI_PHYSICAL_MAXIMUM(8, MOUSE_WHEEL_MULTIPLIER),
+                HID_RI_REPORT_COUNT(8, 0x01),
+                HID_RI_REPORT_SIZE(8, 0x02),
+                HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+                HID_RI_REPORT_SIZE(8, 0x04),
+                HID_RI_FEATURE(8, HID_IOF_CONSTANT),
+
+                HID_RI_USAGE_PAGE(8, 0x0C), /* Consumer */
+                HID_RI_USAGE(16, 0x0238), /* AC Pan (Horizontal wheel) */
+                HID_RI_LOGICAL_MINIMUM(8, -127),
+                HID_RI_LOGICAL_MAXIMUM(8, 127),
+                HID_RI_PHYSICAL_MINIMUM(8, 0), /* reset physical */
+                HID_RI_PHYSICAL_MAXIMUM(8, 0),
+                HID_RI_REPORT_COUNT(8, 0x01),
+                HID_RI_REPORT_SIZE(8, 0x08),
+                HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE),
+            HID_RI_END_COLLECTION(0),
+#else
             HID_RI_USAGE(8, 0x38), /* Wheel */
             HID_RI_LOGICAL_MINIMUM(8, -127),
             HID_RI_LOGICAL_MAXIMUM(8, 127),
@@ -127,6 +179,7 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM MouseReport[] =
             HID_RI_REPORT_COUNT(8, 0x01),
             HID_RI_REPORT_SIZE(8, 0x08),
             HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE),
+#endif
 
         HID_RI_END_COLLECTION(0),
     HID_RI_END_COLLECTION(0),
@@ -323,8 +376,14 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
             .TotalEndpoints         = 1,
 
             .Class                  = HID_CSCP_HIDClass,
+#ifdef MOUSE_EXTENDED_REPORT
+            /* boot protocol report has 8-bit X and Y */
+            .SubClass               = HID_CSCP_NonBootSubclass,
+            .Protocol               = HID_CSCP_NonBootProtocol,
+#else
             .SubClass               = HID_CSCP_BootSubclass,
             .Protocol               = HID_CSCP_MouseBootProtocol,
+#endif
 
             .InterfaceStrIndex      = NO_DESCRIPTOR
         },
@@ -56,7 +56,27 @@ uint8_t keyboard_idle = 0;
 uint8_t keyboard_protocol = 1;
 static uint8_t keyboard_led_stats = 0;
 
-static report_keyboard_t keyboard_report_sent;
+/* Keyboard report send queue */
+#ifndef KBUF_SIZE
+#define KBUF_SIZE 8
+#endif
+#define KBUF_NEXT(i) (((i) + 1) % KBUF_SIZE)
+#define KBUF_PREV(i) (((i) + KBUF_SIZE - 1) % KBUF_SIZE)
+typedef struct {
+    report_keyboard_t report;
+    bool nkro;
+} kbuf_entry_t;
+static kbuf_entry_t kbuf[KBUF_SIZE];
+static volatile uint8_t kbuf_head = 0;
+static volatile uint8_t kbuf_tail = 0;
+uint16_t kbuf_overflow = 0;
+
+static kbuf_entry_t keyboard_report_sent;
+
+#ifdef MOUSE_ENABLE
+/* mouse reports not accepted by endpoint yet */
+static report_mouse_queue_t mouse_queue;
+#endif
 
 
 /* Host driver */
@@ -78,12 +98,44 @@ host_driver_t lufa_driver = {
  * Console
  ******************************************************************************/
 #ifdef CONSOLE_ENABLE
+/* Console output FIFO
+ * sendchar fills it without waiting and Console_Task sends it from Start-of-
+ * Frame event in full packets, partial packet goes when no output comes in a
+ * frame. Output while FIFO is full is dropped and counted. */
+#ifndef CONSOLE_BUFFER_SIZE
+#define CONSOLE_BUFFER_SIZE 128
+#endif
+#if CONSOLE_BUFFER_SIZE > 255
+#error "CONSOLE_BUFFER_SIZE must be 255 or less."
+#endif
+static uint8_t console_buf[CONSOLE_BUFFER_SIZE];
+static volatile uint8_t console_head = 0;
+static volatile uint8_t console_tail = 0;
+static uint8_t console_count_last = 0;
+uint16_t console_dropped = 0;
+
+static uint8_t console_count(void)
+{
+    uint8_t head = console_head;
+    uint8_t tail = console_tail;
+    return (head >= tail ? head - tail : CONSOLE_BUFFER_SIZE - tail + head);
+}
+
 static void Console_Task(void)
 {
     /* Device must be connected and configured for the task to run */
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+    /* wait to fill packet while output is coming */
+    uint8_t count = console_count();
+    if (!count)
+        return;
+    if (count < CONSOLE_EPSIZE && count != console_count_last) {
+        console_count_last = count;
+        return;
+    }
+
     uint8_t ep = Endpoint_GetCurrentEndpoint();
 
 #if 0
@@ -118,13 +170,18 @@ static void Console_Task(void)
         return;
     }
 
-    // fill empty bank
-    while (Endpoint_IsReadWriteAllowed())
-        Endpoint_Write_8(0);
-
-    // flash senchar packet
-    if (Endpoint_IsINReady()) {
+    // try again next frame if host has not read previous packet yet
+    if (Endpoint_IsReadWriteAllowed()) {
+        uint8_t n = 0;
+        for (; n < CONSOLE_EPSIZE && console_tail != console_head; n++) {
+            Endpoint_Write_8(console_buf[console_tail]);
+            console_tail = (console_tail + 1 == CONSOLE_BUFFER_SIZE ? 0 : console_tail + 1);
+        }
+        for (; n < CONSOLE_EPSIZE; n++) {
+            Endpoint_Write_8(0);
+        }
         Endpoint_ClearIN();
+        console_count_last = console_count();
     }
 
     Endpoint_SelectEndpoint(ep);
@@ -136,6 +193,81 @@ static void Console_Task(void)
 #endif
 
 
+/*******************************************************************************
+ * Keyboard
+ ******************************************************************************/
+/* Sends oldest queued keyboard report if endpoint is ready.
+ * This is called from Start-of-Frame event with KEYBOARD_SOF_SYNC_ENABLE,
+ * otherwise from main loop and send_keyboard. */
+static void Keyboard_Task(void)
+{
+    if (kbuf_head == kbuf_tail)
+        return;
+
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    kbuf_entry_t *entry = &kbuf[kbuf_tail];
+    uint8_t size;
+
+#ifdef NKRO_ENABLE
+    if (entry->nkro) {
+        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
+        size = NKRO_EPSIZE;
+    }
+    else
+#endif
+    {
+        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
+        size = KEYBOARD_EPSIZE;
+    }
+
+    // try again later if host has not read previous one yet
+    if (Endpoint_IsReadWriteAllowed()) {
+        Endpoint_Write_Stream_LE(&entry->report, size, NULL);
+        Endpoint_ClearIN();
+
+        keyboard_report_sent = *entry;
+        kbuf_tail = KBUF_NEXT(kbuf_tail);
+    }
+
+    Endpoint_SelectEndpoint(ep);
+}
+
+
+/*******************************************************************************
+ * Mouse
+ ******************************************************************************/
+#ifdef MOUSE_ENABLE
+/* Sends pending mouse report if endpoint is ready */
+static void Mouse_Task(void)
+{
+    if (!mouse_queue.count)
+        return;
+
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
+
+    if (Endpoint_IsReadWriteAllowed()) {
+        Endpoint_Write_Stream_LE(&mouse_queue.report[0], sizeof(report_mouse_t), NULL);
+        Endpoint_ClearIN();
+
+        report_mouse_sent(&mouse_queue);
+    }
+
+    Endpoint_SelectEndpoint(ep);
+}
+#else
+static void Mouse_Task(void)
+{
+}
+#endif
+
+
 /*******************************************************************************
  * USB Events
  ******************************************************************************/
@@ -174,6 +306,10 @@ void EVENT_USB_Device_Disconnect(void)
 void EVENT_USB_Device_Reset(void)
 {
     print("[R]");
+    kbuf_head = kbuf_tail = 0;
+#ifdef MOUSE_WHEEL_HIRES
+    mouse_resolution_multiplier = 0;
+#endif
 }
 
 void EVENT_USB_Device_Suspend()
@@ -199,6 +335,9 @@ void EVENT_USB_Device_WakeUp()
 
 void EVENT_USB_Device_StartOfFrame(void)
 {
+#ifdef KEYBOARD_SOF_SYNC_ENABLE
+    Keyboard_Task();
+#endif
     Console_Task();
 }
 
@@ -275,9 +414,17 @@ void EVENT_USB_Device_ControlRequest(void)
                 switch (USB_ControlRequest.wIndex) {
                 case KEYBOARD_INTERFACE:
                     // TODO: test/check
-                    ReportData = (uint8_t*)&keyboard_report_sent;
-                    ReportSize = sizeof(keyboard_report_sent);
+                    ReportData = (uint8_t*)&keyboard_report_sent.report;
+                    ReportSize = sizeof(keyboard_report_sent.report);
                     break;
+#if defined(MOUSE_ENABLE) && defined(MOUSE_WHEEL_HIRES)
+                case MOUSE_INTERFACE:
+                    if ((USB_ControlRequest.wValue >> 8) == 0x03) {   // Feature report
+                        ReportData = &mouse_resolution_multiplier;
+                        ReportSize = sizeof(mouse_resolution_multiplier);
+                    }
+                    break;
+#endif
                 }
 
                 /* Write the report data to the control endpoint */
@@ -307,6 +454,21 @@ void EVENT_USB_Device_ControlRequest(void)
                     Endpoint_ClearOUT();
                     Endpoint_ClearStatusStage();
                     break;
+#if defined(MOUSE_ENABLE) && defined(MOUSE_WHEEL_HIRES)
+                case MOUSE_INTERFACE:
+                    Endpoint_ClearSETUP();
+
+                    while (!(Endpoint_IsOUTReceived())) {
+                        if (USB_DeviceState == DEVICE_STATE_Unattached)
+                          return;
+                    }
+                    if ((USB_ControlRequest.wValue >> 8) == 0x03)   // Feature report
+                        mouse_resolution_multiplier = Endpoint_Read_8();
+
+                    Endpoint_ClearOUT();
+                    Endpoint_ClearStatusStage();
+                    break;
+#endif
                 }
 
             }
@@ -377,41 +539,56 @@ static uint8_t keyboard_leds(void)
 static void send_keyboard(report_keyboard_t *report)
 {
     uint8_t timeout = 255;
+    bool nkro = false;
 
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
-    /* Select the Keyboard Report Endpoint */
 #ifdef NKRO_ENABLE
-    if (keyboard_nkro) {
-        /* Report protocol - NKRO */
-        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 1ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(4);
-        if (!Endpoint_IsReadWriteAllowed()) return;
+    nkro = keyboard_nkro;
+#endif
 
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, NKRO_EPSIZE, NULL);
-    }
-    else
+    /* Queue report. Merge it into newest queued one when host can't tell the
+     * difference. When queue is full wait for a report to be sent for a
+     * polling interval around 10ms, then replace newest queued one. */
+    while (1) {
+        uint8_t sreg = SREG;
+        cli();
+
+        uint8_t slot = kbuf_head;
+        if (kbuf_head != kbuf_tail) {
+            uint8_t last = KBUF_PREV(kbuf_head);
+            kbuf_entry_t *prev = (last == kbuf_tail) ? &keyboard_report_sent : &kbuf[KBUF_PREV(last)];
+            if (prev->nkro == nkro && kbuf[last].nkro == nkro &&
+                    report_keyboard_mergeable(&prev->report, &kbuf[last].report, report, nkro)) {
+                slot = last;
+            } else if (KBUF_NEXT(kbuf_head) == kbuf_tail) {
+                if (timeout--) {
+                    SREG = sreg;
+#ifndef KEYBOARD_SOF_SYNC_ENABLE
+                    Keyboard_Task();
 #endif
-    {
-        /* Boot protocol */
-        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
+                    _delay_us(40);
+                    continue;
+                }
+                kbuf_overflow++;
+                dprint("kbuf: full\n");
+                slot = last;
+            }
+        }
 
-        /* Check if write ready for a polling interval around 10ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-        if (!Endpoint_IsReadWriteAllowed()) return;
+        kbuf[slot].report = *report;
+        kbuf[slot].nkro = nkro;
+        if (slot == kbuf_head)
+            kbuf_head = KBUF_NEXT(kbuf_head);
 
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, KEYBOARD_EPSIZE, NULL);
+        SREG = sreg;
+        break;
     }
 
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
-
-    keyboard_report_sent = *report;
+#ifndef KEYBOARD_SOF_SYNC_ENABLE
+    Keyboard_Task();
+#endif
 }
 
 static void send_mouse(report_mouse_t *report)
@@ -422,18 +599,19 @@ static void send_mouse(report_mouse_t *report)
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
-    /* Select the Mouse Report Endpoint */
-    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    /* Write Mouse Report Data */
-    Endpoint_Write_Stream_LE(report, sizeof(report_mouse_t), NULL);
+    /* Add motion to reports endpoint has not accepted yet. When both of them
+     * have button change wait for one to be sent for a polling interval around
+     * 10ms, then give up motion of this report but not its buttons. */
+    while (!report_mouse_put(&mouse_queue, report)) {
+        if (!timeout--) {
+            mouse_queue.report[1].buttons = report->buttons;
+            break;
+        }
+        Mouse_Task();
+        if (mouse_queue.count == 2) _delay_us(40);
+    }
 
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+    Mouse_Task();
 #endif
 }
 
@@ -484,60 +662,48 @@ static void send_consumer(uint16_t data)
  * sendchar
  ******************************************************************************/
 #ifdef CONSOLE_ENABLE
-#define SEND_TIMEOUT 5
+/* Queues output to console FIFO, this never waits for host. */
 int8_t sendchar(uint8_t c)
 {
-    // Not wait once timeouted.
-    // Because sendchar() is called so many times, waiting each call causes big lag.
-    static bool timeouted = false;
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return -1;
 
-    uint8_t ep = Endpoint_GetCurrentEndpoint();
-    Endpoint_SelectEndpoint(CONSOLE_IN_EPNUM);
-    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
-        goto ERROR_EXIT;
-    }
-
-    if (timeouted && !Endpoint_IsReadWriteAllowed()) {
-        goto ERROR_EXIT;
-    }
-
-    timeouted = false;
-
-    uint8_t timeout = SEND_TIMEOUT;
-    while (!Endpoint_IsReadWriteAllowed()) {
-        if (USB_DeviceState != DEVICE_STATE_Configured) {
-            goto ERROR_EXIT;
-        }
-        if (Endpoint_IsStalled()) {
-            goto ERROR_EXIT;
-        }
-        if (!(timeout--)) {
-            timeouted = true;
-            goto ERROR_EXIT;
-        }
-        _delay_ms(1);
+    /* can be called from interrupt as well */
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t next = (console_head + 1 == CONSOLE_BUFFER_SIZE ? 0 : console_head + 1);
+    if (next == console_tail) {
+        console_dropped++;
+        SREG = sreg;
+        return -1;
     }
+    console_buf[console_head] = c;
+    console_head = next;
+    SREG = sreg;
+    return 0;
+}
 
-    Endpoint_Write_8(c);
-
-    // send when bank is full
-    if (!Endpoint_IsReadWriteAllowed())
-        Endpoint_ClearIN();
+uint8_t sendchar_free(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return 0;
 
-    Endpoint_SelectEndpoint(ep);
-    return 0;
-ERROR_EXIT:
-    Endpoint_SelectEndpoint(ep);
-    return -1;
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t free = CONSOLE_BUFFER_SIZE - 1 - console_count();
+    SREG = sreg;
+    return free;
 }
 #else
 int8_t sendchar(uint8_t c)
 {
     return 0;
 }
+
+uint8_t sendchar_free(void)
+{
+    return UINT8_MAX;
+}
 #endif
 
 
@@ -601,5 +767,10 @@ int main(void)
 #if !defined(INTERRUPT_CONTROL_ENDPOINT)
         USB_USBTask();
 #endif
+
+#ifndef KEYBOARD_SOF_SYNC_ENABLE
+        Keyboard_Task();
+#endif
+        Mouse_Task();
     }
 }
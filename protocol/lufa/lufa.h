@@ -56,6 +56,14 @@ extern "C" {
 
 extern host_driver_t lufa_driver;
 
+/* number of keyboard reports replaced because send queue stayed full */
+extern uint16_t kbuf_overflow;
+
+#ifdef CONSOLE_ENABLE
+/* number of console output bytes dropped because FIFO was full */
+extern uint16_t console_dropped;
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -68,5 +68,6 @@ int main(void)
         }
 
         keyboard_task(); 
+        pjrc_transfer_mouse();
     }
 }
@@ -23,6 +23,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pjrc.h"
 
 
+#ifdef MOUSE_ENABLE
+/* mouse reports not accepted by endpoint yet */
+static report_mouse_queue_t mouse_queue;
+
+/* send oldest pending mouse report, usb_mouse_send waits for endpoint up to 50 frames */
+static void mouse_send_pending(void)
+{
+    report_mouse_t *r = &mouse_queue.report[0];
+    if (usb_mouse_send(r->x, r->y, r->v, r->h, r->buttons) == 0) {
+        report_mouse_sent(&mouse_queue);
+    }
+}
+#endif
+
+/* send pending mouse report if endpoint is ready */
+void pjrc_transfer_mouse(void)
+{
+#ifdef MOUSE_ENABLE
+    if (!mouse_queue.count || !usb_mouse_ready()) return;
+    mouse_send_pending();
+#endif
+}
+
+
 /*------------------------------------------------------------------*
  * Host driver
  *------------------------------------------------------------------*/
@@ -57,7 +81,16 @@ static void send_keyboard(report_keyboard_t *report)
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
-    usb_mouse_send(report->x, report->y, report->v, report->h, report->buttons);
+    /* Add motion to reports endpoint has not accepted yet. When both of them
+     * have button change send one, then give up motion of this report but not
+     * its buttons if endpoint still doesn't accept it. */
+    if (!report_mouse_put(&mouse_queue, report)) {
+        mouse_send_pending();
+        if (!report_mouse_put(&mouse_queue, report))
+            mouse_queue.report[1].buttons = report->buttons;
+    }
+
+    pjrc_transfer_mouse();
 #endif
 }
 
@@ -22,5 +22,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 host_driver_t *pjrc_driver(void);
+void pjrc_transfer_mouse(void);
 
 #endif
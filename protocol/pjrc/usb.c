@@ -257,11 +257,60 @@ static const uint8_t PROGMEM mouse_hid_report_desc[] = {
     0x05, 0x01,                    //     USAGE_PAGE (Generic Desktop)
     0x09, 0x30,                    //     USAGE (X)
     0x09, 0x31,                    //     USAGE (Y)
+#ifdef MOUSE_EXTENDED_REPORT
+    0x16, 0x01, 0x80,              //     LOGICAL_MINIMUM (-32767)
+    0x26, 0xff, 0x7f,              //     LOGICAL_MAXIMUM (32767)
+    0x75, 0x10,                    //     REPORT_SIZE (16)
+#else
     0x15, 0x81,                    //     LOGICAL_MINIMUM (-127)
     0x25, 0x7f,                    //     LOGICAL_MAXIMUM (127)
     0x75, 0x08,                    //     REPORT_SIZE (8)
+#endif
     0x95, 0x02,                    //     REPORT_COUNT (2)
     0x81, 0x06,                    //     INPUT (Data,Var,Rel)
+#ifdef MOUSE_WHEEL_HIRES
+                                   // ----------------------------  Vertical wheel
+    0xa1, 0x02,                    //     COLLECTION (Logical)
+    0x09, 0x48,                    //       USAGE (Resolution Multiplier)
+    0x15, 0x00,                    //       LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //       LOGICAL_MAXIMUM (1)
+    0x35, 0x01,                    //       PHYSICAL_MINIMUM (1)
+    0x45, MOUSE_WHEEL_MULTIPLIER,  //       PHYSICAL_MAXIMUM (MOUSE_WHEEL_MULTIPLIER)
+    0x75, 0x02,                    //       REPORT_SIZE (2)
+    0x95, 0x01,                    //       REPORT_COUNT (1)
+    0xb1, 0x02,                    //       FEATURE (Data,Var,Abs)
+    0x09, 0x38,                    //       USAGE (Wheel)
+    0x15, 0x81,                    //       LOGICAL_MINIMUM (-127)
+    0x25, 0x7f,                    //       LOGICAL_MAXIMUM (127)
+    0x35, 0x00,                    //       PHYSICAL_MINIMUM (0)        - reset physical
+    0x45, 0x00,                    //       PHYSICAL_MAXIMUM (0)
+    0x75, 0x08,                    //       REPORT_SIZE (8)
+    0x95, 0x01,                    //       REPORT_COUNT (1)
+    0x81, 0x06,                    //       INPUT (Data,Var,Rel)
+    0xc0,                          //     END_COLLECTION
+                                   // ----------------------------  Horizontal wheel
+    0xa1, 0x02,                    //     COLLECTION (Logical)
+    0x09, 0x48,                    //       USAGE (Resolution Multiplier)
+    0x15, 0x00,                    //       LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //       LOGICAL_MAXIMUM (1)
+    0x35, 0x01,                    //       PHYSICAL_MINIMUM (1)
+    0x45, MOUSE_WHEEL_MULTIPLIER,  //       PHYSICAL_MAXIMUM (MOUSE_WHEEL_MULTIPLIER)
+    0x75, 0x02,                    //       REPORT_SIZE (2)
+    0x95, 0x01,                    //       REPORT_COUNT (1)
+    0xb1, 0x02,                    //       FEATURE (Data,Var,Abs)
+    0x75, 0x04,                    //       REPORT_SIZE (4)
+    0xb1, 0x03,                    //       FEATURE (Cnst,Var,Abs)
+    0x05, 0x0c,                    //       USAGE_PAGE (Consumer Devices)
+    0x0a, 0x38, 0x02,              //       USAGE (AC Pan)
+    0x15, 0x81,                    //       LOGICAL_MINIMUM (-127)
+    0x25, 0x7f,                    //       LOGICAL_MAXIMUM (127)
+    0x35, 0x00,                    //       PHYSICAL_MINIMUM (0)        - reset physical
+    0x45, 0x00,                    //       PHYSICAL_MAXIMUM (0)
+    0x75, 0x08,                    //       REPORT_SIZE (8)
+    0x95, 0x01,                    //       REPORT_COUNT (1)
+    0x81, 0x06,                    //       INPUT (Data,Var,Rel)
+    0xc0,                          //     END_COLLECTION
+#else
                                    // ----------------------------  Vertical wheel
     0x09, 0x38,                    //     USAGE (Wheel)
     0x15, 0x81,                    //     LOGICAL_MINIMUM (-127)
@@ -279,6 +328,7 @@ static const uint8_t PROGMEM mouse_hid_report_desc[] = {
     0x75, 0x08,                    //     REPORT_SIZE (8)
     0x95, 0x01,                    //     REPORT_COUNT (1)
     0x81, 0x06,                    //     INPUT (Data,Var,Rel)
+#endif
     0xc0,                          //   END_COLLECTION
     0xc0,                          // END_COLLECTION
 };
@@ -647,7 +697,7 @@ void usb_remote_wakeup(void)
 //
 ISR(USB_GEN_vect)
 {
-	uint8_t intbits, t;
+	uint8_t intbits;
 	static uint8_t div4=0;
 
         intbits = UDINT;
@@ -679,19 +729,12 @@ ISR(USB_GEN_vect)
 		UECFG1X = EP_SIZE(ENDPOINT0_SIZE) | EP_SINGLE_BUFFER;
 		UEIENX = (1<<RXSTPE);
 		usb_configuration = 0;
+#ifdef MOUSE_WHEEL_HIRES
+		mouse_resolution_multiplier = 0;
+#endif
         }
 	if ((intbits & (1<<SOFI)) && usb_configuration) {
-		t = debug_flush_timer;
-		if (t) {
-			debug_flush_timer = -- t;
-			if (!t) {
-				UENUM = DEBUG_TX_ENDPOINT;
-				while ((UEINTX & (1<<RWAL))) {
-					UEDATX = 0;
-				}
-				UEINTX = 0x3A;
-			}
-		}
+		usb_debug_sof();
                 /* TODO: should keep IDLE rate on each keyboard interface */
 #ifdef NKRO_ENABLE
 		if (!keyboard_nkro && keyboard_idle && (++div4 & 3) == 0) {
@@ -945,6 +988,14 @@ ISR(USB_COM_vect)
 		if (wIndex == MOUSE_INTERFACE) {
 			if (bmRequestType == 0xA1) {
 				if (bRequest == HID_GET_REPORT) {
+#ifdef MOUSE_WHEEL_HIRES
+                                    if ((wValue >> 8) == HID_REPORT_FEATURE) {
+					usb_wait_in_ready();
+					UEDATX = mouse_resolution_multiplier;
+					usb_send_in();
+					return;
+                                    }
+#endif
                                     if (wValue == HID_REPORT_INPUT) {
 					usb_wait_in_ready();
 					UEDATX = 0;
@@ -969,6 +1020,15 @@ ISR(USB_COM_vect)
 				}
 			}
 			if (bmRequestType == 0x21) {
+#ifdef MOUSE_WHEEL_HIRES
+				if (bRequest == HID_SET_REPORT && (wValue >> 8) == HID_REPORT_FEATURE) {
+					usb_wait_receive_out();
+					mouse_resolution_multiplier = UEDATX;
+					usb_ack_out();
+					usb_send_in();
+					return;
+				}
+#endif
 				if (bRequest == HID_SET_PROTOCOL) {
 					usb_mouse_protocol = wValue;
 					usb_send_in();
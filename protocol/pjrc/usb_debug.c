@@ -26,15 +26,27 @@
 #include "usb_debug.h"
 
 
+// output waiting for endpoint, sendchar fills it and SOF interrupt sends
+// it in full packets.  Output while it is full is dropped and counted.
+#ifndef DEBUG_FIFO_SIZE
+#define DEBUG_FIFO_SIZE		128
+#endif
+#if DEBUG_FIFO_SIZE > 255
+#error "DEBUG_FIFO_SIZE must be 255 or less."
+#endif
+static uint8_t debug_fifo[DEBUG_FIFO_SIZE];
+static volatile uint8_t debug_fifo_head=0;
+static volatile uint8_t debug_fifo_tail=0;
+uint16_t debug_dropped=0;
+
 // the time remaining before we transmit any partially full
-// packet, or send a zero length packet.
+// packet.
 volatile uint8_t debug_flush_timer=0;
 
 
 int8_t sendchar(uint8_t c)
 {
-	static uint8_t previous_timeout=0;
-	uint8_t timeout, intr_state;
+	uint8_t intr_state, next;
 
 	// if we're not online (enumerated and configured), error
 	if (!usb_configured()) return -1;
@@ -43,46 +55,71 @@ int8_t sendchar(uint8_t c)
 	// even both in the same program!
 	intr_state = SREG;
 	cli();
-	UENUM = DEBUG_TX_ENDPOINT;
-	// if we gave up due to timeout before, don't wait again
-	if (previous_timeout) {
-		if (!(UEINTX & (1<<RWAL))) {
-			SREG = intr_state;
-			return -1;
-		}
-		previous_timeout = 0;
-	}
-	// wait for the FIFO to be ready to accept data
-	timeout = UDFNUML + 4;
-	while (1) {
-		// are we ready to transmit?
-		if (UEINTX & (1<<RWAL)) break;
+	next = debug_fifo_head + 1;
+	if (next >= DEBUG_FIFO_SIZE) next = 0;
+	if (next == debug_fifo_tail) {
+		debug_dropped++;
 		SREG = intr_state;
-		// have we waited too long?
-		if (UDFNUML == timeout) {
-			previous_timeout = 1;
-			return -1;
-		}
-		// has the USB gone offline?
-		if (!usb_configured()) return -1;
-		// get ready to try checking again
-		intr_state = SREG;
-		cli();
-		UENUM = DEBUG_TX_ENDPOINT;
-	}
-	// actually write the byte into the FIFO
-	UEDATX = c;
-	// if this completed a packet, transmit it now!
-	if (!(UEINTX & (1<<RWAL))) {
-		UEINTX = 0x3A;
-		debug_flush_timer = 0;
-	} else {
-		debug_flush_timer = 2;
+		return -1;
 	}
+	debug_fifo[debug_fifo_head] = c;
+	debug_fifo_head = next;
+	debug_flush_timer = 2;
 	SREG = intr_state;
 	return 0;
 }
 
+static uint8_t fifo_count(void)
+{
+	uint8_t head = debug_fifo_head, tail = debug_fifo_tail;
+	return (head >= tail) ? head - tail : DEBUG_FIFO_SIZE - tail + head;
+}
+
+uint8_t sendchar_free(void)
+{
+	uint8_t intr_state, n;
+
+	if (!usb_configured()) return 0;
+	intr_state = SREG;
+	cli();
+	n = DEBUG_FIFO_SIZE - 1 - fifo_count();
+	SREG = intr_state;
+	return n;
+}
+
+// write one packet from FIFO if endpoint has room, interrupts must be
+// disabled.  returns 0 when endpoint is busy.
+static uint8_t send_packet(void)
+{
+	uint8_t tail = debug_fifo_tail;
+
+	UENUM = DEBUG_TX_ENDPOINT;
+	if (!(UEINTX & (1<<RWAL))) return 0;
+	while ((UEINTX & (1<<RWAL)) && tail != debug_fifo_head) {
+		UEDATX = debug_fifo[tail];
+		if (++tail >= DEBUG_FIFO_SIZE) tail = 0;
+	}
+	debug_fifo_tail = tail;
+	while ((UEINTX & (1<<RWAL))) {
+		UEDATX = 0;
+	}
+	UEINTX = 0x3A;
+	return 1;
+}
+
+// called from SOF interrupt.  full packets go at once, partial packet
+// after output stops for a while.
+void usb_debug_sof(void)
+{
+	uint8_t count = fifo_count();
+
+	if (!count) return;
+	if (count < DEBUG_TX_SIZE && debug_flush_timer) {
+		if (--debug_flush_timer) return;
+	}
+	send_packet();
+}
+
 // immediately transmit any buffered output.
 void usb_debug_flush_output(void)
 {
@@ -90,13 +127,7 @@ void usb_debug_flush_output(void)
 
 	intr_state = SREG;
 	cli();
-	if (debug_flush_timer) {
-		UENUM = DEBUG_TX_ENDPOINT;
-		while ((UEINTX & (1<<RWAL))) {
-			UEDATX = 0;
-		}
-		UEINTX = 0x3A;
-		debug_flush_timer = 0;
-	}
+	while (fifo_count() && send_packet()) ;
+	debug_flush_timer = 0;
 	SREG = intr_state;
 }
@@ -35,8 +35,10 @@
 
 
 extern volatile uint8_t debug_flush_timer;
+extern uint16_t debug_dropped;		// output bytes dropped as FIFO was full
 
 
 void usb_debug_flush_output(void);	// immediately transmit any buffered output
+void usb_debug_sof(void);		// send buffered output, from SOF interrupt
 
 #endif
@@ -31,13 +31,25 @@
 uint8_t usb_mouse_protocol=1;
 
 
-int8_t usb_mouse_send(int8_t x, int8_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons)
+int8_t usb_mouse_send(mouse_xy_report_t x, mouse_xy_report_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons)
 {
 	uint8_t intr_state, timeout;
 
 	if (!usb_configured()) return -1;
+#ifdef MOUSE_EXTENDED_REPORT
+	// boot protocol report has 8-bit X and Y
+	if (!usb_mouse_protocol) {
+		if (x < -127) x = -127;
+		if (x > 127) x = 127;
+		if (y < -127) y = -127;
+		if (y > 127) y = 127;
+	}
+	if (x == -32768) x = -32767;
+	if (y == -32768) y = -32767;
+#else
 	if (x == -128) x = -127;
 	if (y == -128) y = -127;
+#endif
 	if (wheel_v == -128) wheel_v = -127;
 	if (wheel_h == -128) wheel_h = -127;
 	intr_state = SREG;
@@ -58,8 +70,20 @@ int8_t usb_mouse_send(int8_t x, int8_t y, int8_t wheel_v, int8_t wheel_h, uint8_
 		UENUM = MOUSE_ENDPOINT;
 	}
 	UEDATX = buttons;
+#ifdef MOUSE_EXTENDED_REPORT
+	if (usb_mouse_protocol) {
+		UEDATX = x & 0xFF;
+		UEDATX = x >> 8;
+		UEDATX = y & 0xFF;
+		UEDATX = y >> 8;
+	} else {
+		UEDATX = x;
+		UEDATX = y;
+	}
+#else
 	UEDATX = x;
 	UEDATX = y;
+#endif
         if (usb_mouse_protocol) {
             UEDATX = wheel_v;
             UEDATX = wheel_h;
@@ -70,12 +94,31 @@ int8_t usb_mouse_send(int8_t x, int8_t y, int8_t wheel_v, int8_t wheel_h, uint8_
 	return 0;
 }
 
-void usb_mouse_print(int8_t x, int8_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons) {
+bool usb_mouse_ready(void)
+{
+	uint8_t intr_state;
+	bool ready;
+
+	if (!usb_configured()) return false;
+	intr_state = SREG;
+	cli();
+	UENUM = MOUSE_ENDPOINT;
+	ready = UEINTX & (1<<RWAL);
+	SREG = intr_state;
+	return ready;
+}
+
+void usb_mouse_print(mouse_xy_report_t x, mouse_xy_report_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons) {
     if (!debug_mouse) return;
     print("usb_mouse[btn|x y v h]: ");
     phex(buttons); print("|");
+#ifdef MOUSE_EXTENDED_REPORT
+    phex16(x); print(" ");
+    phex16(y); print(" ");
+#else
     phex(x); print(" ");
     phex(y); print(" ");
+#endif
     phex(wheel_v); print(" ");
     phex(wheel_h); print("\n");
 }
@@ -27,6 +27,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "usb.h"
+#include "report.h"
 
 
 #define MOUSE_INTERFACE		1
@@ -44,7 +45,8 @@
 extern uint8_t usb_mouse_protocol;
 
 
-int8_t usb_mouse_send(int8_t x, int8_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons);
-void usb_mouse_print(int8_t x, int8_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons);
+int8_t usb_mouse_send(mouse_xy_report_t x, mouse_xy_report_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons);
+bool usb_mouse_ready(void);
+void usb_mouse_print(mouse_xy_report_t x, mouse_xy_report_t y, int8_t wheel_v, int8_t wheel_h, uint8_t buttons);
 
 #endif
@@ -86,13 +86,40 @@ POSSIBILITY OF SUCH DAMAGE.
 
 extern uint8_t ps2_error;
 
+/* receive errors counted by driver */
+typedef struct {
+    uint16_t parity;
+    uint16_t frame;     // start or stop bit error
+    uint16_t timeout;   // clock edge didn't come in time and frame is resynchronized
+    uint16_t overflow;  // receive buffer full
+    uint16_t resend;    // resend requested to device
+} ps2_error_count_t;
+
+extern ps2_error_count_t ps2_error_count;
+
 void ps2_host_init(void);
 uint8_t ps2_host_send(uint8_t data);
 uint8_t ps2_host_recv_response(void);
 uint8_t ps2_host_recv(void);
+/* true once after byte is lost by receive error, device should be asked to resend(PS2_RESEND) */
+bool ps2_host_recv_failed(void);
 void ps2_host_set_led(uint8_t usb_led);
 
 
+/*
+ * Device decoder called in receive interrupt with data not waited as response
+ */
+#if defined(PS2_KBD_ENABLE)
+#   include "ps2_kbd.h"
+#   define PS2_RECV_DEVICE(data)    ps2_kbd_recv(data)
+#elif defined(PS2_MOUSE_ENABLE)
+#   include "ps2_mouse.h"
+#   ifdef PS2_MOUSE_STREAM_MODE
+#       define PS2_RECV_DEVICE(data)    ps2_mouse_recv(data)
+#   endif
+#endif
+
+
 /*--------------------------------------------------------------------
  * static functions
  *------------------------------------------------------------------*/
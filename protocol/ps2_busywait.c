@@ -53,8 +53,15 @@ POSSIBILITY OF SUCH DAMAGE.
     } \
 } while (0)
 
+/* error of WAIT in ps2_host_recv when stop bit is low */
+#define ERR_STOPBIT     9
+
 
 uint8_t ps2_error = PS2_ERR_NONE;
+ps2_error_count_t ps2_error_count;
+
+/* byte lost by receive error */
+static bool recv_failed = false;
 
 
 void ps2_host_init(void)
@@ -160,27 +167,48 @@ uint8_t ps2_host_recv(void)
 
     /* parity [10] */
     WAIT(clock_lo, 50, 6);
-    if (data_in() != parity) {
-        ps2_error = PS2_ERR_PARITY;
-        goto ERROR;
-    }
+    bool parity_error = (data_in() != parity);
     WAIT(clock_hi, 50, 7);
 
     /* stop bit [11] */
     WAIT(clock_lo, 50, 8);
-    WAIT(data_hi, 1, 9);
+    WAIT(data_hi, 1, ERR_STOPBIT);
     WAIT(clock_hi, 50, 10);
 
+    /* frame with parity error is received to the end, or device sends it again by itself */
+    if (parity_error) {
+        ps2_error = PS2_ERR_PARITY;
+        goto ERROR;
+    }
+
     inhibit();
     return data;
 ERROR:
     if (ps2_error > PS2_ERR_STARTBIT3) {
+        // Device sends again by itself when it is inhibited before end of
+        // frame, resend is requested only for broken frame received wholly.
+        if (ps2_error == PS2_ERR_PARITY) {
+            ps2_error_count.parity++;
+            recv_failed = true;
+        } else if (ps2_error == ERR_STOPBIT) {
+            ps2_error_count.frame++;
+            recv_failed = true;
+        } else {
+            ps2_error_count.timeout++;
+        }
         xprintf("x%02X\n", ps2_error);
     }
     inhibit();
     return 0;
 }
 
+bool ps2_host_recv_failed(void)
+{
+    bool failed = recv_failed;
+    recv_failed = false;
+    return failed;
+}
+
 /* send LED state to keyboard */
 void ps2_host_set_led(uint8_t led)
 {
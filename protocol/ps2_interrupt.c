@@ -45,7 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "ps2.h"
 #include "ps2_io.h"
 #include "print.h"
-
+#include "timer.h"
 
 #define WAIT(stat, us, err) do { \
     if (!wait_##stat(us)) { \
@@ -56,6 +56,18 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 uint8_t ps2_error = PS2_ERR_NONE;
+ps2_error_count_t ps2_error_count;
+
+/* frame is aborted when next clock edge doesn't come in this time(us) */
+#ifndef PS2_BIT_TIMEOUT
+#define PS2_BIT_TIMEOUT     200
+#endif
+#define BIT_TIMEOUT_RAW     ((uint16_t)PS2_BIT_TIMEOUT * (TIMER_RAW_FREQ / 1000) / 1000)
+
+/* byte lost by receive error */
+static volatile bool recv_failed = false;
+/* frame being received is aborted by host */
+static volatile bool recv_abort = false;
 
 
 static inline uint8_t pbuf_dequeue(void);
@@ -63,6 +75,11 @@ static inline void pbuf_enqueue(uint8_t data);
 static inline bool pbuf_has_data(void);
 static inline void pbuf_clear(void);
 
+#ifdef PS2_RECV_DEVICE
+/* received data go to pbuf while host waits for response, to device decoder otherwise */
+static volatile bool recv_response = false;
+#endif
+
 
 void ps2_host_init(void)
 {
@@ -79,6 +96,11 @@ uint8_t ps2_host_send(uint8_t data)
     ps2_error = PS2_ERR_NONE;
 
     PS2_INT_OFF();
+    recv_abort = true;
+#ifdef PS2_RECV_DEVICE
+    recv_response = true;
+    pbuf_clear();
+#endif
 
     /* terminate a transmission if we have */
     inhibit();
@@ -124,6 +146,9 @@ uint8_t ps2_host_send(uint8_t data)
     PS2_INT_ON();
     return ps2_host_recv_response();
 ERROR:
+#ifdef PS2_RECV_DEVICE
+    recv_response = false;
+#endif
     idle();
     PS2_INT_ON();
     return 0;
@@ -132,9 +157,20 @@ ERROR:
 uint8_t ps2_host_recv_response(void)
 {
     // Command may take 25ms/20ms at most([5]p.46, [3]p.21)
-    uint8_t retry = 25;
+    // 250 * 100us, shorter than a frame so that next byte goes to device decoder
+    uint8_t retry = 250;
+#ifdef PS2_RECV_DEVICE
+    recv_response = true;
+#endif
     while (retry-- && !pbuf_has_data()) {
-        _delay_ms(1);
+        _delay_us(100);
+    }
+#ifdef PS2_RECV_DEVICE
+    recv_response = false;
+#endif
+    if (!pbuf_has_data()) {
+        ps2_error = PS2_ERR_NODATA;
+        return 0;
     }
     return pbuf_dequeue();
 }
@@ -151,6 +187,34 @@ uint8_t ps2_host_recv(void)
     }
 }
 
+bool ps2_host_recv_failed(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    bool failed = recv_failed;
+    recv_failed = false;
+    SREG = sreg;
+    return failed;
+}
+
+/* Checks time from previous falling edge of clock, called in interrupt. */
+static inline bool edge_timeout(void)
+{
+    static uint8_t last_ms = 0;
+    static uint8_t last_raw = 0;
+
+    uint8_t ms = timer_count;
+    uint8_t raw = TIMER_RAW;
+    uint8_t n = ms - last_ms;
+    // counter has wrapped but timer interrupt is still pending
+    if (n == 0 && raw < last_raw) n = 1;
+    bool timeout = (n > 1 ||
+                    (uint16_t)n * (TIMER_RAW_TOP + 1) + raw - last_raw > BIT_TIMEOUT_RAW);
+    last_ms = ms;
+    last_raw = raw;
+    return timeout;
+}
+
 ISR(PS2_INT_VECT)
 {
     static enum {
@@ -163,13 +227,23 @@ ISR(PS2_INT_VECT)
     static uint8_t data = 0;
     static uint8_t parity = 1;
 
-    // TODO: abort if elapse 100us from previous interrupt
-
     // return unless falling edge
     if (clock_in()) {
         goto RETURN;
     }
 
+    if (edge_timeout() || recv_abort) {
+        if (state != INIT && !recv_abort) {
+            // edges lost in frame, this edge is start bit of next one
+            ps2_error_count.timeout++;
+            if (state >= BIT0) recv_failed = true;
+        }
+        recv_abort = false;
+        state = INIT;
+        data = 0;
+        parity = 1;
+    }
+
     state++;
     switch (state) {
         case START:
@@ -191,17 +265,20 @@ ISR(PS2_INT_VECT)
             }
             break;
         case PARITY:
-            if (data_in()) {
-                if (!(parity & 0x01))
-                    goto ERROR;
-            } else {
-                if (parity & 0x01)
-                    goto ERROR;
-            }
+            if (data_in())
+                parity++;
             break;
         case STOP:
-            if (!data_in())
+            // parity is checked at the end of frame, resend requested before
+            // that makes device send the previous byte
+            if (!data_in() || (parity & 0x01))
                 goto ERROR;
+#ifdef PS2_RECV_DEVICE
+            if (!recv_response) {
+                PS2_RECV_DEVICE(data);
+                goto DONE;
+            }
+#endif
             pbuf_enqueue(data);
             goto DONE;
             break;
@@ -211,6 +288,13 @@ ISR(PS2_INT_VECT)
     goto RETURN;
 ERROR:
     ps2_error = state;
+    if (state == STOP && (parity & 0x01)) {
+        ps2_error = PS2_ERR_PARITY;
+        ps2_error_count.parity++;
+    } else {
+        ps2_error_count.frame++;
+    }
+    if (state == STOP) recv_failed = true;
 DONE:
     state = INIT;
     data = 0;
@@ -243,6 +327,7 @@ static inline void pbuf_enqueue(uint8_t data)
         pbuf[pbuf_head] = data;
         pbuf_head = next;
     } else {
+        ps2_error_count.overflow++;
         print("pbuf: full\n");
     }
     SREG = sreg;
@@ -0,0 +1,527 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+#include "progmem.h"
+#include "print.h"
+#include "ps2.h"
+#include "ps2_kbd.h"
+
+#if (PS2_KBD_EVENT_SIZE & (PS2_KBD_EVENT_SIZE - 1))
+#error "PS2_KBD_EVENT_SIZE must be power of 2."
+#endif
+
+/* events are put in receive interrupt */
+#if defined(PS2_USE_INT) || defined(PS2_USE_USART)
+#include <avr/interrupt.h>
+#define ATOMIC_BEGIN()  uint8_t sreg = SREG; cli()
+#define ATOMIC_END()    SREG = sreg
+#else
+#define ATOMIC_BEGIN()
+#define ATOMIC_END()
+#endif
+
+
+/*--------------------------------------------------------------------
+ * Event queue
+ *------------------------------------------------------------------*/
+#define EVENT_NEXT(i)   (((i) + 1) & (PS2_KBD_EVENT_SIZE - 1))
+#define EVENT_ROOM()    ((uint8_t)(event_tail - event_head - 1) & (PS2_KBD_EVENT_SIZE - 1))
+static ps2_kbd_event_t events[PS2_KBD_EVENT_SIZE];
+static volatile uint8_t event_head = 0;
+static volatile uint8_t event_tail = 0;
+/* events lost when queue is full, CLEAR event takes their place */
+static volatile bool event_lost = false;
+
+static void event_put(uint8_t code, bool make)
+{
+    uint16_t time = timer_read();
+
+    ATOMIC_BEGIN();
+    if (event_lost && EVENT_ROOM() >= 2) {
+        events[event_head] = (ps2_kbd_event_t){ .code = PS2_KBD_CLEAR, .make = false, .time = time };
+        event_head = EVENT_NEXT(event_head);
+        event_lost = false;
+    }
+    if (!event_lost && EVENT_ROOM()) {
+        events[event_head] = (ps2_kbd_event_t){ .code = code, .make = make, .time = time };
+        event_head = EVENT_NEXT(event_head);
+    } else {
+        event_lost = true;
+    }
+    ATOMIC_END();
+}
+
+bool ps2_kbd_event_peek(ps2_kbd_event_t *event)
+{
+    bool has_event = true;
+
+    ATOMIC_BEGIN();
+    if (event_head != event_tail) {
+        *event = events[event_tail];
+    } else if (event_lost) {
+        *event = (ps2_kbd_event_t){ .code = PS2_KBD_CLEAR, .make = false, .time = timer_read() };
+    } else {
+        has_event = false;
+    }
+    ATOMIC_END();
+    return has_event;
+}
+
+void ps2_kbd_event_remove(void)
+{
+    ATOMIC_BEGIN();
+    if (event_head != event_tail) {
+        event_tail = EVENT_NEXT(event_tail);
+    } else {
+        event_lost = false;
+    }
+    ATOMIC_END();
+}
+
+
+/*--------------------------------------------------------------------
+ * Notices
+ *
+ * Decoder runs in receive interrupt, where printing would hold off the
+ * following bytes. It leaves notices here and ps2_kbd_task prints them.
+ *------------------------------------------------------------------*/
+#define NOTICE_BAT          (1<<0)
+#define NOTICE_ERROR        (1<<1)  // scan code error, code in notice_error_code
+#define NOTICE_UNKNOWN      (1<<2)  // unknown Set 3 code, in notice_unknown_code
+static volatile uint8_t notice = 0;
+static volatile uint8_t notice_error_code = 0;
+static volatile uint8_t notice_unknown_code = 0;
+
+static void notice_error(uint8_t code)
+{
+    notice |= NOTICE_ERROR;
+    notice_error_code = code;
+}
+
+static void notice_print(void)
+{
+    ATOMIC_BEGIN();
+    uint8_t n = notice;
+    uint8_t error_code = notice_error_code;
+    uint8_t unknown_code = notice_unknown_code;
+    notice = 0;
+    ATOMIC_END();
+
+    if (n & NOTICE_BAT) print("BAT\n");
+    if (n & NOTICE_ERROR) xprintf("scan code error: %02X\n", error_code);
+    if (n & NOTICE_UNKNOWN) xprintf("unknown scan code: %02X\n", unknown_code);
+}
+
+
+static void keyboard_reset(void);
+
+
+/*--------------------------------------------------------------------
+ * Scan Code Set 2 decoder
+ *
+ * Sequences of Set 2, see converter/ps2_usb/matrix.c for exceptional keys.
+ *
+ *     XX                       make of XX
+ *     F0 XX                    break of XX
+ *     E0 XX                    make of XX|0x80
+ *     E0 F0 XX                 break of XX|0x80
+ *     84, F0 84                make and break of PrintScreen(Alt'd)
+ *     E0 12, E0 59             ignored(fake shift)
+ *     E0 F0 12, E0 F0 59       ignored(fake shift)
+ *     E1 14 77 E1 F0 14 F0 77  make of Pause
+ *     E0 7E E0 F0 7E           make of Pause(Control'd)
+ *     AA                       BAT completion, keyboard is reset to Set 2
+ *
+ * These are described below as states and transitions on byte, and table of
+ * state and byte class is generated from them at compile time. Bytes having
+ * no transition take default action of state and go back to INIT.
+ *------------------------------------------------------------------*/
+/*    state                     key byte    other byte */
+#define SET2_STATES(S) \
+    S(INIT,                     MAKE,       CLEAR) \
+    S(F0,                       BREAK,      CLEAR) \
+    S(E0,                       MAKE_E0,    CLEAR) \
+    S(E0_F0,                    BREAK_E0,   CLEAR) \
+    S(E1,                       NONE,       NONE) \
+    S(E1_14,                    NONE,       NONE) \
+    S(E1_14_77,                 NONE,       NONE) \
+    S(E1_14_77_E1,              NONE,       NONE) \
+    S(E1_14_77_E1_F0,           NONE,       NONE) \
+    S(E1_14_77_E1_F0_14,        NONE,       NONE) \
+    S(E1_14_77_E1_F0_14_F0,     NONE,       NONE) \
+    S(E0_7E,                    NONE,       NONE) \
+    S(E0_7E_E0,                 NONE,       NONE) \
+    S(E0_7E_E0_F0,              NONE,       NONE)
+
+/*    state                     byte    action              next state */
+#define SET2_TRANSITIONS(T) \
+    T(INIT,                     E0,     NONE,               E0) \
+    T(INIT,                     F0,     NONE,               F0) \
+    T(INIT,                     E1,     NONE,               E1) \
+    T(INIT,                     84,     MAKE_PRINT_SCREEN,  INIT) \
+    T(INIT,                     AA,     RESET,              INIT) \
+    T(F0,                       84,     BREAK_PRINT_SCREEN, INIT) \
+    T(F0,                       F0,     CLEAR,              F0) \
+    T(E0,                       12,     NONE,               INIT) \
+    T(E0,                       59,     NONE,               INIT) \
+    T(E0,                       7E,     NONE,               E0_7E) \
+    T(E0,                       83,     CLEAR,              INIT) \
+    T(E0,                       F0,     NONE,               E0_F0) \
+    T(E0_F0,                    12,     NONE,               INIT) \
+    T(E0_F0,                    59,     NONE,               INIT) \
+    T(E0_F0,                    83,     CLEAR,              INIT) \
+    T(E1,                       14,     NONE,               E1_14) \
+    T(E1_14,                    77,     NONE,               E1_14_77) \
+    T(E1_14_77,                 E1,     NONE,               E1_14_77_E1) \
+    T(E1_14_77_E1,              F0,     NONE,               E1_14_77_E1_F0) \
+    T(E1_14_77_E1_F0,           14,     NONE,               E1_14_77_E1_F0_14) \
+    T(E1_14_77_E1_F0_14,        F0,     NONE,               E1_14_77_E1_F0_14_F0) \
+    T(E1_14_77_E1_F0_14_F0,     77,     MAKE_PAUSE,         INIT) \
+    T(E0_7E,                    E0,     NONE,               E0_7E_E0) \
+    T(E0_7E_E0,                 F0,     NONE,               E0_7E_E0_F0) \
+    T(E0_7E_E0_F0,              7E,     MAKE_PAUSE,         INIT)
+
+/* bytes used in transitions have own class, key bytes(00-7F and F7 83) first */
+#define SET2_KEY_BYTES(B)   B(12) B(14) B(59) B(77) B(7E) B(83)
+#define SET2_OTHER_BYTES(B) B(84) B(AA) B(E0) B(E1) B(F0)
+
+enum set2_state {
+#define STATE_ID(state, key, other)     S_##state,
+    SET2_STATES(STATE_ID)
+#undef STATE_ID
+    S_NUM
+};
+
+enum set2_class {
+    C_KEY,
+#define CLASS_ID(byte)  C_##byte,
+    SET2_KEY_BYTES(CLASS_ID)
+    C_OTHER,
+    SET2_OTHER_BYTES(CLASS_ID)
+#undef CLASS_ID
+    C_NUM
+};
+
+enum decode_action {
+    A_NONE,
+    A_MAKE,
+    A_BREAK,
+    A_MAKE_E0,
+    A_BREAK_E0,
+    A_MAKE_PRINT_SCREEN,
+    A_BREAK_PRINT_SCREEN,
+    A_MAKE_PAUSE,
+    A_CLEAR,
+    A_RESET,
+};
+
+/* table entry: action(bit 7-4) and next state(bit 3-0) */
+#define ENTRY(action, next)     (A_##action<<4 | S_##next)
+#define ENTRY_ACTION(e)         ((e)>>4)
+#define ENTRY_NEXT(e)           ((e) & 0x0F)
+
+#if S_NUM > 16
+#error "Set 2 states exceed table entry."
+#endif
+
+static const uint8_t set2_class[256] PROGMEM = {
+    [0x00] = C_OTHER,   // Overrun [3]p.25
+    [0x01 ... 0x7F] = C_KEY,
+    [0x80 ... 0xFF] = C_OTHER,
+#define CLASS_ENTRY(byte)   [0x##byte] = C_##byte,
+    SET2_KEY_BYTES(CLASS_ENTRY)
+    SET2_OTHER_BYTES(CLASS_ENTRY)
+#undef CLASS_ENTRY
+};
+
+static const uint8_t set2_table[S_NUM][C_NUM] PROGMEM = {
+#define STATE_ENTRY(state, key, other) \
+    [S_##state][0 ... C_OTHER - 1] = ENTRY(key, INIT), \
+    [S_##state][C_OTHER ... C_NUM - 1] = ENTRY(other, INIT),
+    SET2_STATES(STATE_ENTRY)
+#undef STATE_ENTRY
+#define TRANSITION_ENTRY(state, byte, action, next) \
+    [S_##state][C_##byte] = ENTRY(action, next),
+    SET2_TRANSITIONS(TRANSITION_ENTRY)
+#undef TRANSITION_ENTRY
+};
+
+static uint8_t set2_state = S_INIT;
+
+static void set2_recv(uint8_t code)
+{
+    uint8_t entry = pgm_read_byte(&set2_table[set2_state][pgm_read_byte(&set2_class[code])]);
+    set2_state = ENTRY_NEXT(entry);
+
+    switch (ENTRY_ACTION(entry)) {
+        case A_MAKE:
+            event_put(code, true);
+            break;
+        case A_BREAK:
+            event_put(code, false);
+            break;
+        case A_MAKE_E0:
+            event_put(code|0x80, true);
+            break;
+        case A_BREAK_E0:
+            event_put(code|0x80, false);
+            break;
+        case A_MAKE_PRINT_SCREEN:
+            event_put(PS2_KBD_PRINT_SCREEN, true);
+            break;
+        case A_BREAK_PRINT_SCREEN:
+            event_put(PS2_KBD_PRINT_SCREEN, false);
+            break;
+        case A_MAKE_PAUSE:
+            event_put(PS2_KBD_PAUSE, true);
+            break;
+        case A_CLEAR:
+            event_put(PS2_KBD_CLEAR, false);
+            notice_error(code);
+            break;
+        case A_RESET:
+            keyboard_reset();
+            break;
+    }
+}
+
+/*--------------------------------------------------------------------
+ * Scan Code Set 3 decoder
+ *
+ *     XX                       make
+ *     F0 XX                    break
+ *
+ * Keyboard is configured to send make and break of all keys(F8). Codes are
+ * translated into Set 2 positions so that keymaps work with both sets.
+ *------------------------------------------------------------------*/
+static const uint8_t set3_to_set2[0x88] PROGMEM = {
+    [0x07] = 0x05,  // F1
+    [0x08] = 0x76,  // Esc
+    [0x0D] = 0x0D,  // Tab
+    [0x0E] = 0x0E,  // `
+    [0x0F] = 0x06,  // F2
+    [0x11] = 0x14,  // LCtrl
+    [0x12] = 0x12,  // LShift
+    [0x13] = 0x61,  // ISO Backslash
+    [0x14] = 0x58,  // CapsLock
+    [0x15] = 0x15,  // Q
+    [0x16] = 0x16,  // 1
+    [0x17] = 0x04,  // F3
+    [0x19] = 0x11,  // LAlt
+    [0x1A] = 0x1A,  // Z
+    [0x1B] = 0x1B,  // S
+    [0x1C] = 0x1C,  // A
+    [0x1D] = 0x1D,  // W
+    [0x1E] = 0x1E,  // 2
+    [0x1F] = 0x0C,  // F4
+    [0x21] = 0x21,  // C
+    [0x22] = 0x22,  // X
+    [0x23] = 0x23,  // D
+    [0x24] = 0x24,  // E
+    [0x25] = 0x25,  // 4
+    [0x26] = 0x26,  // 3
+    [0x27] = 0x03,  // F5
+    [0x29] = 0x29,  // Space
+    [0x2A] = 0x2A,  // V
+    [0x2B] = 0x2B,  // F
+    [0x2C] = 0x2C,  // T
+    [0x2D] = 0x2D,  // R
+    [0x2E] = 0x2E,  // 5
+    [0x2F] = 0x0B,  // F6
+    [0x31] = 0x31,  // N
+    [0x32] = 0x32,  // B
+    [0x33] = 0x33,  // H
+    [0x34] = 0x34,  // G
+    [0x35] = 0x35,  // Y
+    [0x36] = 0x36,  // 6
+    [0x37] = 0x83,  // F7
+    [0x39] = 0x91,  // RAlt
+    [0x3A] = 0x3A,  // M
+    [0x3B] = 0x3B,  // J
+    [0x3C] = 0x3C,  // U
+    [0x3D] = 0x3D,  // 7
+    [0x3E] = 0x3E,  // 8
+    [0x3F] = 0x0A,  // F8
+    [0x41] = 0x41,  // ,
+    [0x42] = 0x42,  // K
+    [0x43] = 0x43,  // I
+    [0x44] = 0x44,  // O
+    [0x45] = 0x45,  // 0
+    [0x46] = 0x46,  // 9
+    [0x47] = 0x01,  // F9
+    [0x49] = 0x49,  // .
+    [0x4A] = 0x4A,  // /
+    [0x4B] = 0x4B,  // L
+    [0x4C] = 0x4C,  // ;
+    [0x4D] = 0x4D,  // P
+    [0x4E] = 0x4E,  // -
+    [0x4F] = 0x09,  // F10
+    [0x51] = 0x51,  // JIS Ro
+    [0x52] = 0x52,  // '
+    [0x53] = 0x5D,  // ISO #
+    [0x54] = 0x54,  // [
+    [0x55] = 0x55,  // =
+    [0x56] = 0x78,  // F11
+    [0x57] = PS2_KBD_PRINT_SCREEN,
+    [0x58] = 0x94,  // RCtrl
+    [0x59] = 0x59,  // RShift
+    [0x5A] = 0x5A,  // Enter
+    [0x5B] = 0x5B,  // ]
+    [0x5C] = 0x5D,  // Backslash
+    [0x5D] = 0x6A,  // JIS Yen
+    [0x5E] = 0x07,  // F12
+    [0x5F] = 0x7E,  // ScrollLock
+    [0x60] = 0xF2,  // Down
+    [0x61] = 0xEB,  // Left
+    [0x62] = PS2_KBD_PAUSE,
+    [0x63] = 0xF5,  // Up
+    [0x64] = 0xF1,  // Delete
+    [0x65] = 0xE9,  // End
+    [0x66] = 0x66,  // Backspace
+    [0x67] = 0xF0,  // Insert
+    [0x69] = 0x69,  // KP 1
+    [0x6A] = 0xF4,  // Right
+    [0x6B] = 0x6B,  // KP 4
+    [0x6C] = 0x6C,  // KP 7
+    [0x6D] = 0xFA,  // PageDown
+    [0x6E] = 0xEC,  // Home
+    [0x6F] = 0xFD,  // PageUp
+    [0x70] = 0x70,  // KP 0
+    [0x71] = 0x71,  // KP .
+    [0x72] = 0x72,  // KP 2
+    [0x73] = 0x73,  // KP 5
+    [0x74] = 0x74,  // KP 6
+    [0x75] = 0x75,  // KP 8
+    [0x76] = 0x77,  // NumLock
+    [0x77] = 0xCA,  // KP /
+    [0x79] = 0xDA,  // KP Enter
+    [0x7A] = 0x7A,  // KP 3
+    [0x7C] = 0x79,  // KP +
+    [0x7D] = 0x7D,  // KP 9
+    [0x7E] = 0x7C,  // KP *
+    [0x84] = 0x7B,  // KP -
+    [0x85] = 0x67,  // JIS Muhenkan
+    [0x86] = 0x64,  // JIS Henkan
+    [0x87] = 0x13,  // JIS Kana
+};
+
+static bool set3_f0 = false;
+
+static void set3_recv(uint8_t code)
+{
+    if (code == 0xF0) {
+        set3_f0 = true;
+        return;
+    }
+    if (code == 0xAA && !set3_f0) {
+        keyboard_reset();
+        return;
+    }
+
+    uint8_t key = (code < sizeof(set3_to_set2) ? pgm_read_byte(&set3_to_set2[code]) : 0);
+    if (key) {
+        event_put(key, !set3_f0);
+    } else if (code == 0x00) {  // Overrun
+        event_put(PS2_KBD_CLEAR, false);
+        notice_error(code);
+    } else {
+        notice |= NOTICE_UNKNOWN;
+        notice_unknown_code = code;
+    }
+    set3_f0 = false;
+}
+
+
+/*--------------------------------------------------------------------
+ * Scan code set
+ *------------------------------------------------------------------*/
+static uint8_t code_set = 0;
+
+void ps2_kbd_set_code_set(uint8_t set)
+{
+    ATOMIC_BEGIN();
+    code_set = set;
+    set2_state = S_INIT;
+    set3_f0 = false;
+    ATOMIC_END();
+}
+
+uint8_t ps2_kbd_code_set(void)
+{
+    return code_set;
+}
+
+/* keyboard starts again in Set 2 after BAT */
+static void keyboard_reset(void)
+{
+    event_put(PS2_KBD_CLEAR, false);
+    code_set = 0;
+    set2_state = S_INIT;
+    set3_f0 = false;
+    notice |= NOTICE_BAT;
+}
+
+void ps2_kbd_recv(uint8_t code)
+{
+    if (code_set == 3) {
+        set3_recv(code);
+    } else {
+        set2_recv(code);
+    }
+}
+
+/* times to ask keyboard to send again byte lost by receive error */
+#ifndef PS2_KBD_RESEND_RETRY
+#define PS2_KBD_RESEND_RETRY    3
+#endif
+
+void ps2_kbd_task(void)
+{
+#ifdef PS2_USE_BUSYWAIT
+    // Pause sequence is 8 bytes
+    for (uint8_t i = 0; i < 8; i++) {
+        uint8_t code = ps2_host_recv();
+        if (ps2_error) break;
+        ps2_kbd_recv(code);
+    }
+#endif
+    if (notice) notice_print();
+
+    if (!ps2_host_recv_failed()) return;
+
+    for (uint8_t i = 0; i < PS2_KBD_RESEND_RETRY; i++) {
+        ps2_error_count.resend++;
+        uint8_t code = ps2_host_send(PS2_RESEND);
+        if (!ps2_error && !ps2_host_recv_failed()) {
+            // decoder state is shared with receive interrupt
+            ATOMIC_BEGIN();
+            ps2_kbd_recv(code);
+            ATOMIC_END();
+            return;
+        }
+    }
+
+    // sequence is broken by the byte lost
+    ATOMIC_BEGIN();
+    set2_state = S_INIT;
+    set3_f0 = false;
+    event_put(PS2_KBD_CLEAR, false);
+    ATOMIC_END();
+    print("PS/2 byte lost\n");
+}
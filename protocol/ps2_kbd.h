@@ -0,0 +1,72 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PS2_KBD_H
+#define PS2_KBD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*
+ * PS/2 keyboard scan code decoder
+ *
+ * Scan code bytes are decoded as soon as they are received, in receive
+ * interrupt with PS2_USE_INT and PS2_USE_USART or in ps2_kbd_task() with
+ * PS2_USE_BUSYWAIT, and complete key events are queued with time of the
+ * last byte of the sequence.
+ *
+ * Key code of event is position in 256 cell matrix:
+ *     00-7F    Scan Code Set 2 code without prefix
+ *     80-FF    E0-prefixed code with 0x80
+ * and exceptions below. Scan Code Set 3 codes are translated into the same
+ * positions.
+ */
+#define PS2_KBD_F7              0x83    // F7(83) is beyond 0x7F
+#define PS2_KBD_PRINT_SCREEN    0xFC
+#define PS2_KBD_PAUSE           0xFE    // make only in Set 2, no break code
+#define PS2_KBD_CLEAR           0x00    // all keys off: overrun, unexpected code or lost events
+
+/* events in queue, power of 2 */
+#ifndef PS2_KBD_EVENT_SIZE
+#define PS2_KBD_EVENT_SIZE      16
+#endif
+
+typedef struct {
+    uint8_t  code;
+    bool     make;
+    uint16_t time;
+} ps2_kbd_event_t;
+
+
+/* selects scan code set 2 or 3 keyboard is configured to, 0 means Set 2 after reset */
+void ps2_kbd_set_code_set(uint8_t set);
+/* 0 after BAT(power-on or hot plug) until set is selected */
+uint8_t ps2_kbd_code_set(void);
+
+/* feeds received byte to decoder, called by PS/2 driver */
+void ps2_kbd_recv(uint8_t data);
+
+/* receives and decodes bytes without interrupt driver and prints decoder
+ * notices like BAT, call this before getting events */
+void ps2_kbd_task(void);
+
+/* gets oldest event and leaves it in queue, false when no event */
+bool ps2_kbd_event_peek(ps2_kbd_event_t *event);
+/* removes oldest event */
+void ps2_kbd_event_remove(void);
+
+#endif
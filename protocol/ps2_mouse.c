@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdbool.h>
 #include<avr/io.h>
+#include<avr/interrupt.h>
 #include<util/delay.h>
 #include "ps2.h"
 #include "ps2_mouse.h"
@@ -26,14 +27,105 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "debug.h"
 
+#if (PS2_MOUSE_PACKET_QUEUE_SIZE & (PS2_MOUSE_PACKET_QUEUE_SIZE - 1))
+#error "PS2_MOUSE_PACKET_QUEUE_SIZE must be power of 2."
+#endif
+
 
 static report_mouse_t mouse_report = {};
 
+/* movement of packets merged into one report */
+typedef struct {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int16_t v;
+    int16_t h;
+} mouse_move_t;
+
+/* standard 3-byte packet, or 4-byte with wheel of IntelliMouse */
+static uint8_t device_id = PS2_MOUSE_ID_STANDARD;
+static uint8_t packet_size = 3;
+
 
 static void print_usb_data(void);
 
 
-/* supports only 3 button mouse at this time */
+#ifdef PS2_MOUSE_STREAM_MODE
+/*
+ * Packet queue
+ *
+ * Receive interrupt assembles packet and queues it when complete, ps2_mouse_task
+ * takes packets out.
+ */
+static uint8_t packet_buf[PS2_MOUSE_PACKET_MAX];
+static volatile uint8_t packet_index = 0;
+static uint8_t packet_queue[PS2_MOUSE_PACKET_QUEUE_SIZE][PS2_MOUSE_PACKET_MAX];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+#define QUEUE_NEXT(i)   (((i) + 1) & (PS2_MOUSE_PACKET_QUEUE_SIZE - 1))
+
+void ps2_mouse_recv(uint8_t data)
+{
+    /* skip bytes until first byte of packet to get in sync */
+    if (packet_index == 0 && !(data & (1<<PS2_MOUSE_SYNC))) return;
+
+    packet_buf[packet_index++] = data;
+    if (packet_index < packet_size) return;
+    packet_index = 0;
+
+    if (QUEUE_NEXT(queue_head) == queue_tail) {
+        ps2_error_count.overflow++;
+        return;
+    }
+    for (uint8_t i = 0; i < PS2_MOUSE_PACKET_MAX; i++) {
+        packet_queue[queue_head][i] = packet_buf[i];
+    }
+    queue_head = QUEUE_NEXT(queue_head);
+}
+
+static bool packet_dequeue(uint8_t *packet)
+{
+    if (queue_tail == queue_head) return false;
+    for (uint8_t i = 0; i < PS2_MOUSE_PACKET_MAX; i++) {
+        packet[i] = packet_queue[queue_tail][i];
+    }
+    queue_tail = QUEUE_NEXT(queue_tail);
+    return true;
+}
+
+/* starts new packet with next byte */
+static void packet_reset(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    packet_index = 0;
+    SREG = sreg;
+}
+#endif
+
+/* sends command with argument and returns true when both are acknowledged */
+static bool send_arg(uint8_t command, uint8_t arg)
+{
+    return (ps2_host_send(command) == PS2_ACK && ps2_host_send(arg) == PS2_ACK);
+}
+
+/* sets sample rates in magic sequence and returns Device ID mouse reports then */
+static uint8_t knock(uint8_t rate1, uint8_t rate2, uint8_t rate3)
+{
+    if (!send_arg(PS2_MOUSE_SET_SAMPLE_RATE, rate1) ||
+            !send_arg(PS2_MOUSE_SET_SAMPLE_RATE, rate2) ||
+            !send_arg(PS2_MOUSE_SET_SAMPLE_RATE, rate3)) {
+        return PS2_MOUSE_ID_STANDARD;
+    }
+    if (ps2_host_send(PS2_MOUSE_GET_DEVICE_ID) != PS2_ACK) {
+        return PS2_MOUSE_ID_STANDARD;
+    }
+    return ps2_host_recv_response();
+}
+
+
+/* supports 3 button mouse, IntelliMouse with wheel and IntelliMouse Explorer with 5 buttons */
 uint8_t ps2_mouse_init(void) {
     uint8_t rcv;
 
@@ -42,7 +134,7 @@ uint8_t ps2_mouse_init(void) {
     _delay_ms(1000);    // wait for powering up
 
     // send Reset
-    rcv = ps2_host_send(0xFF);
+    rcv = ps2_host_send(PS2_MOUSE_RESET);
     print("ps2_mouse_init: send Reset: ");
     phex(rcv); phex(ps2_error); print("\n");
 
@@ -56,74 +148,155 @@ uint8_t ps2_mouse_init(void) {
     print("ps2_mouse_init: read DevID: ");
     phex(rcv); phex(ps2_error); print("\n");
 
+    // IntelliMouse and Explorer extensions are enabled by sample rate sequences
+    if (knock(200, 100, 80) == PS2_MOUSE_ID_INTELLIMOUSE) {
+        device_id = PS2_MOUSE_ID_INTELLIMOUSE;
+        packet_size = 4;
+        if (knock(200, 200, 80) == PS2_MOUSE_ID_EXPLORER) {
+            device_id = PS2_MOUSE_ID_EXPLORER;
+            // horizontal wheel of IntelliMouse Explorer 4.0, others ignore this
+            send_arg(PS2_MOUSE_SET_SAMPLE_RATE, 200);
+            send_arg(PS2_MOUSE_SET_SAMPLE_RATE, 80);
+            send_arg(PS2_MOUSE_SET_SAMPLE_RATE, 40);
+        }
+    }
+    print("ps2_mouse_init: DevID: ");
+    phex(device_id); print("\n");
+
+#ifdef PS2_MOUSE_STREAM_MODE
+    // Stream mode is default after Reset, mouse may refuse rate it doesn't support
+    uint8_t rate = PS2_MOUSE_SAMPLE_RATE;
+    if (!send_arg(PS2_MOUSE_SET_SAMPLE_RATE, rate)) {
+        rate = 100;
+        send_arg(PS2_MOUSE_SET_SAMPLE_RATE, rate);
+    }
+    print("ps2_mouse_init: sample rate: ");
+    print_dec(rate); print("\n");
+
+    // send Enable Data Reporting
+    packet_reset();
+    rcv = ps2_host_send(PS2_MOUSE_ENABLE_DATA_REPORTING);
+    print("ps2_mouse_init: send 0xF4: ");
+    phex(rcv); phex(ps2_error); print("\n");
+#else
     // send Set Remote mode
-    rcv = ps2_host_send(0xF0);
+    rcv = ps2_host_send(PS2_MOUSE_SET_REMOTE_MODE);
     print("ps2_mouse_init: send 0xF0: ");
     phex(rcv); phex(ps2_error); print("\n");
+#endif
 
     return 0;
 }
 
-#define X_IS_NEG  (mouse_report.buttons & (1<<PS2_MOUSE_X_SIGN))
-#define Y_IS_NEG  (mouse_report.buttons & (1<<PS2_MOUSE_Y_SIGN))
-#define X_IS_OVF  (mouse_report.buttons & (1<<PS2_MOUSE_X_OVFLW))
-#define Y_IS_OVF  (mouse_report.buttons & (1<<PS2_MOUSE_Y_OVFLW))
-void ps2_mouse_task(void)
+/* wheel of report is 8-bit while X and Y can be wider and multiplied by wheel resolution */
+static int8_t scroll_clamp(int16_t d)
 {
-    enum { SCROLL_NONE, SCROLL_BTN, SCROLL_SENT };
-    static uint8_t scroll_state = SCROLL_NONE;
-    static uint8_t buttons_prev = 0;
+    return (d > 127 ? 127 : (d < -127 ? -127 : d));
+}
 
-    /* receives packet from mouse */
-    uint8_t rcv;
-    rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
-    if (rcv == PS2_ACK) {
-        mouse_report.buttons = ps2_host_recv_response();
-        mouse_report.x = ps2_host_recv_response();
-        mouse_report.y = ps2_host_recv_response();
-    } else {
-        if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
-        return;
+/* USB HID mouse indicates 8bit data(-127 to 127), or 16bit with MOUSE_EXTENDED_REPORT */
+static mouse_xy_report_t xy_clamp(int16_t d)
+{
+    return (d > MOUSE_XY_MAX ? MOUSE_XY_MAX : (d < -MOUSE_XY_MAX ? -MOUSE_XY_MAX : d));
+}
+
+/* Btn4 and Btn5 of Explorer, not in packet with 6-bit wheel */
+static uint8_t buttons_ext = 0;
+
+static bool packet_wheel6(uint8_t *packet)
+{
+    uint8_t w = packet[3] & ((1<<PS2_MOUSE_WHEEL_V) | (1<<PS2_MOUSE_WHEEL_H));
+    return (w == (1<<PS2_MOUSE_WHEEL_V) || w == (1<<PS2_MOUSE_WHEEL_H));
+}
+
+/* buttons of packet as those of USB HID mouse */
+static uint8_t packet_buttons(uint8_t *packet)
+{
+    uint8_t buttons = packet[0] & PS2_MOUSE_BTN_MASK;
+    if (device_id == PS2_MOUSE_ID_EXPLORER) {
+        if (packet_wheel6(packet)) {
+            buttons |= buttons_ext;
+        } else {
+            if (packet[3] & (1<<PS2_MOUSE_BTN_4)) buttons |= MOUSE_BTN4;
+            if (packet[3] & (1<<PS2_MOUSE_BTN_5)) buttons |= MOUSE_BTN5;
+        }
     }
-        xprintf("%ud ", timer_read());
-        print("ps2_mouse raw: [");
-        phex(mouse_report.buttons); print("|");
-        print_hex8((uint8_t)mouse_report.x); print(" ");
-        print_hex8((uint8_t)mouse_report.y); print("]\n");
+    return buttons;
+}
 
-    /* if mouse moves or buttons state changes */
-    if (mouse_report.x || mouse_report.y ||
-            ((mouse_report.buttons ^ buttons_prev) & PS2_MOUSE_BTN_MASK)) {
+// PS/2 mouse data is '9-bit integer'(-256 to 255) which is comprised of sign-bit and 8-bit value.
+// bit: 8    7 ... 0
+//      sign \8-bit/
+//
+// Overflow flag means the movement exceeded 9-bit, use its limit then.
+static int16_t packet_xy(uint8_t b, uint8_t data, uint8_t ovflw, uint8_t sign)
+{
+    if (b & (1<<ovflw)) return (b & (1<<sign)) ? -256 : 255;
+    return (b & (1<<sign)) ? (int16_t)data - 256 : data;
+}
+#define packet_x(packet)    packet_xy(packet[0], packet[1], PS2_MOUSE_X_OVFLW, PS2_MOUSE_X_SIGN)
+#define packet_y(packet)    packet_xy(packet[0], packet[2], PS2_MOUSE_Y_OVFLW, PS2_MOUSE_Y_SIGN)
 
+/* whether X and Y of movement with packet added still fit in report */
+static bool packet_fits(mouse_move_t *move, uint8_t *packet)
+{
+    int16_t x = move->x + packet_x(packet);
+    int16_t y = move->y + packet_y(packet);
+    return (x == xy_clamp(x) && y == xy_clamp(y));
+}
+
+/* adds packet to movement */
+static void packet_merge(mouse_move_t *move, uint8_t *packet)
+{
 #ifdef PS2_MOUSE_DEBUG
-        print("ps2_mouse raw: [");
-        phex(mouse_report.buttons); print("|");
-        print_hex8((uint8_t)mouse_report.x); print(" ");
-        print_hex8((uint8_t)mouse_report.y); print("]\n");
+    print("ps2_mouse raw: [");
+    phex(packet[0]); print("|");
+    print_hex8(packet[1]); print(" ");
+    print_hex8(packet[2]);
+    if (packet_size == 4) { print(" "); print_hex8(packet[3]); }
+    print("]\n");
 #endif
 
-        buttons_prev = mouse_report.buttons;
-
-        // PS/2 mouse data is '9-bit integer'(-256 to 255) which is comprised of sign-bit and 8-bit value.
-        // bit: 8    7 ... 0
-        //      sign \8-bit/
-        //
-        // Meanwhile USB HID mouse indicates 8bit data(-127 to 127), note that -128 is not used.
-        //
-        // This converts PS/2 data into HID value. Use only -127-127 out of PS/2 9-bit.
-        mouse_report.x = X_IS_NEG ?
-                          ((!X_IS_OVF && -127 <= mouse_report.x && mouse_report.x <= -1) ?  mouse_report.x : -127) :
-                          ((!X_IS_OVF && 0 <= mouse_report.x && mouse_report.x <= 127) ? mouse_report.x : 127);
-        mouse_report.y = Y_IS_NEG ?
-                          ((!Y_IS_OVF && -127 <= mouse_report.y && mouse_report.y <= -1) ?  mouse_report.y : -127) :
-                          ((!Y_IS_OVF && 0 <= mouse_report.y && mouse_report.y <= 127) ? mouse_report.y : 127);
-
-        // remove sign and overflow flags
-        mouse_report.buttons &= PS2_MOUSE_BTN_MASK;
+    move->x += packet_x(packet);
+    move->y += packet_y(packet);
+
+    // Z movement of wheel is positive toward user while USB wheel is positive away from user.
+    // Explorer has 4-bit Z with buttons, or 6-bit wheel after horizontal wheel is enabled.
+    uint8_t z = packet[3];
+    if (device_id == PS2_MOUSE_ID_INTELLIMOUSE) {
+        move->v -= (int8_t)z;
+    } else if (device_id == PS2_MOUSE_ID_EXPLORER) {
+        if (!packet_wheel6(packet)) {
+            move->v -= (int8_t)(z << 4) >> 4;
+        } else if (z & (1<<PS2_MOUSE_WHEEL_V)) {
+            move->v -= (int8_t)(z << 2) >> 2;
+        } else {
+            move->h -= (int8_t)(z << 2) >> 2;
+        }
+    }
 
-        // invert coordinate of y to conform to USB HID mouse
-        mouse_report.y = -mouse_report.y;
+    // remove sign and overflow flags
+    move->buttons = packet_buttons(packet);
+    buttons_ext = move->buttons & (MOUSE_BTN4 | MOUSE_BTN5);
+}
 
+static void mouse_send(mouse_move_t *move)
+{
+    enum { SCROLL_NONE, SCROLL_BTN, SCROLL_SENT };
+    static uint8_t scroll_state = SCROLL_NONE;
+    static uint8_t buttons_prev = 0;
+
+    /* if mouse moves or buttons state changes */
+    if (move->x || move->y || move->v || move->h || move->buttons != buttons_prev) {
+        buttons_prev = move->buttons;
+
+        mouse_report.buttons = move->buttons;
+        mouse_report.x = xy_clamp(move->x);
+        // invert coordinate of y to conform to USB HID mouse
+        mouse_report.y = -xy_clamp(move->y);
+        // in units of wheel resolution host requested
+        mouse_report.v = scroll_clamp(move->v * host_mouse_wheel_multiplier_v() * (PS2_MOUSE_WHEEL_SPEED_V));
+        mouse_report.h = scroll_clamp(move->h * host_mouse_wheel_multiplier_h() * (PS2_MOUSE_WHEEL_SPEED_H));
 
 #if PS2_MOUSE_SCROLL_BTN_MASK
         static uint16_t scroll_button_time = 0;
@@ -139,8 +312,9 @@ void ps2_mouse_task(void)
             if (mouse_report.x || mouse_report.y) {
                 scroll_state = SCROLL_SENT;
 
-                mouse_report.v = -mouse_report.y/(PS2_MOUSE_SCROLL_DIVISOR_V);
-                mouse_report.h =  mouse_report.x/(PS2_MOUSE_SCROLL_DIVISOR_H);
+                // in units of wheel resolution host requested
+                mouse_report.v = scroll_clamp(-mouse_report.y * host_mouse_wheel_multiplier_v() / (PS2_MOUSE_SCROLL_DIVISOR_V));
+                mouse_report.h = scroll_clamp( mouse_report.x * host_mouse_wheel_multiplier_h() / (PS2_MOUSE_SCROLL_DIVISOR_H));
                 mouse_report.x = 0;
                 mouse_report.y = 0;
                 //host_mouse_send(&mouse_report);
@@ -175,13 +349,63 @@ void ps2_mouse_task(void)
     mouse_report.buttons = 0;
 }
 
+
+void ps2_mouse_task(void)
+{
+    uint8_t packet[PS2_MOUSE_PACKET_MAX];
+    mouse_move_t move = {};
+
+#ifdef PS2_MOUSE_STREAM_MODE
+    /* byte of packet was lost */
+    if (ps2_host_recv_failed()) {
+        if (debug_mouse) print("ps2_mouse: packet lost\n");
+        packet_reset();
+    }
+
+    /* merges packets queued, report is sent before buttons change not to lose click
+     * and before X or Y exceeds report not to lose movement */
+    bool queued = false;
+    while (packet_dequeue(packet)) {
+        if (queued && (packet_buttons(packet) != move.buttons || !packet_fits(&move, packet))) {
+            mouse_send(&move);
+            move.x = 0;
+            move.y = 0;
+            move.v = 0;
+            move.h = 0;
+        }
+        packet_merge(&move, packet);
+        queued = true;
+    }
+    if (!queued) return;
+#else
+    /* receives packet from mouse */
+    uint8_t rcv;
+    rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
+    if (rcv == PS2_ACK) {
+        for (uint8_t i = 0; i < packet_size; i++) {
+            packet[i] = ps2_host_recv_response();
+        }
+    } else {
+        if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
+        return;
+    }
+    packet_merge(&move, packet);
+#endif
+    mouse_send(&move);
+}
+
 static void print_usb_data(void)
 {
     if (!debug_mouse) return;
     print("ps2_mouse usb: [");
     phex(mouse_report.buttons); print("|");
+#ifdef MOUSE_EXTENDED_REPORT
+    print_hex16((uint16_t)mouse_report.x); print(" ");
+    print_hex16((uint16_t)mouse_report.y); print(" ");
+#else
     print_hex8((uint8_t)mouse_report.x); print(" ");
     print_hex8((uint8_t)mouse_report.y); print(" ");
+#endif
     print_hex8((uint8_t)mouse_report.v); print(" ");
     print_hex8((uint8_t)mouse_report.h); print("]\n");
 }
@@ -209,7 +433,8 @@ static void print_usb_data(void)
  * Stream Mode: devices sends the data when it changs its state
  * Remote Mode: host polls the data periodically
  *
- * This code uses Remote Mode and polls the data with Read Data(0xEB).
+ * This code uses Stream Mode with PS2_USE_INT or PS2_USE_USART, otherwise
+ * Remote Mode and polls the data with Read Data(0xEB).
  *
  * Data format:
  * byte|7       6       5       4       3       2       1       0
@@ -217,4 +442,5 @@ static void print_usb_data(void)
  *    0|Yovflw  Xovflw  Ysign   Xsign   1       Middle  Right   Left
  *    1|                    X movement
  *    2|                    Y movement
+ *    3|                    Z movement(IntelliMouse and Explorer)
  */
@@ -18,9 +18,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef PS2_MOUSE_H
 #define  PS2_MOUSE_H
 
+#include <stdint.h>
 #include <stdbool.h>
 
-#define PS2_MOUSE_READ_DATA     0xEB
+#define PS2_MOUSE_RESET                 0xFF
+#define PS2_MOUSE_ENABLE_DATA_REPORTING 0xF4
+#define PS2_MOUSE_SET_SAMPLE_RATE       0xF3
+#define PS2_MOUSE_GET_DEVICE_ID         0xF2
+#define PS2_MOUSE_SET_REMOTE_MODE       0xF0
+#define PS2_MOUSE_READ_DATA             0xEB
 
 /*
  * Data format:
@@ -34,12 +40,62 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PS2_MOUSE_BTN_LEFT      0
 #define PS2_MOUSE_BTN_RIGHT     1
 #define PS2_MOUSE_BTN_MIDDLE    2
+#define PS2_MOUSE_SYNC          3   // always 1 in first byte of packet
 #define PS2_MOUSE_X_SIGN        4
 #define PS2_MOUSE_Y_SIGN        5
 #define PS2_MOUSE_X_OVFLW       6
 #define PS2_MOUSE_Y_OVFLW       7
 
 
+/*
+ * 4th byte of IntelliMouse(ID 3) and IntelliMouse Explorer(ID 4):
+ * byte|7       6       5       4       3       2       1       0
+ * ----+--------------------------------------------------------------
+ *  ID3|                    Z movement(-128 to 127)
+ *  ID4|0       0       Btn5    Btn4    Z movement(-8 to 7)
+ *  ID4|1       0               vertical wheel(-32 to 31)
+ *  ID4|0       1               horizontal wheel(-32 to 31)
+ * 6-bit wheel is sent by IntelliMouse Explorer 4.0 after rate sequence 200, 80, 40.
+ */
+#define PS2_MOUSE_BTN_4         4
+#define PS2_MOUSE_BTN_5         5
+#define PS2_MOUSE_WHEEL_H       6
+#define PS2_MOUSE_WHEEL_V       7
+
+#define PS2_MOUSE_ID_STANDARD       0x00
+#define PS2_MOUSE_ID_INTELLIMOUSE   0x03
+#define PS2_MOUSE_ID_EXPLORER       0x04
+
+#define PS2_MOUSE_PACKET_MAX    4
+
+
+/*
+ * Stream mode: mouse sends packets at sample rate without being asked and
+ * receive interrupt queues them, used with PS2_USE_INT and PS2_USE_USART.
+ * Remote mode: packet is polled with Read Data in every ps2_mouse_task,
+ * used with PS2_USE_BUSYWAIT or when PS2_MOUSE_USE_REMOTE_MODE is defined.
+ */
+#if !defined(PS2_MOUSE_USE_REMOTE_MODE) && (defined(PS2_USE_INT) || defined(PS2_USE_USART))
+#define PS2_MOUSE_STREAM_MODE
+#endif
+/* samples per second in stream mode: 10, 20, 40, 60, 80, 100 or 200 */
+#ifndef PS2_MOUSE_SAMPLE_RATE
+#define PS2_MOUSE_SAMPLE_RATE           200
+#endif
+/* packets in queue, power of 2 */
+#ifndef PS2_MOUSE_PACKET_QUEUE_SIZE
+#define PS2_MOUSE_PACKET_QUEUE_SIZE     8
+#endif
+
+/* scroll per detent of wheel, in units of wheel resolution host requested */
+#ifndef PS2_MOUSE_WHEEL_SPEED_V
+#define PS2_MOUSE_WHEEL_SPEED_V         1
+#endif
+#ifndef PS2_MOUSE_WHEEL_SPEED_H
+#define PS2_MOUSE_WHEEL_SPEED_H         1
+#endif
+
+
 /*
  * Scroll by mouse move with pressing button
  */
@@ -62,5 +118,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 uint8_t ps2_mouse_init(void);
 void ps2_mouse_task(void);
+/* assembles packet from received byte in stream mode, called by PS/2 driver */
+void ps2_mouse_recv(uint8_t data);
 
 #endif
@@ -46,7 +46,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "ps2_io.h"
 #include "print.h"
 
-
 #define WAIT(stat, us, err) do { \
     if (!wait_##stat(us)) { \
         ps2_error = err; \
@@ -56,6 +55,10 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 uint8_t ps2_error = PS2_ERR_NONE;
+ps2_error_count_t ps2_error_count;
+
+/* byte lost by receive error */
+static volatile bool recv_failed = false;
 
 
 static inline uint8_t pbuf_dequeue(void);
@@ -63,6 +66,11 @@ static inline void pbuf_enqueue(uint8_t data);
 static inline bool pbuf_has_data(void);
 static inline void pbuf_clear(void);
 
+#ifdef PS2_RECV_DEVICE
+/* received data go to pbuf while host waits for response, to device decoder otherwise */
+static volatile bool recv_response = false;
+#endif
+
 
 void ps2_host_init(void)
 {
@@ -79,6 +87,10 @@ uint8_t ps2_host_send(uint8_t data)
     ps2_error = PS2_ERR_NONE;
 
     PS2_USART_OFF();
+#ifdef PS2_RECV_DEVICE
+    recv_response = true;
+    pbuf_clear();
+#endif
 
     /* terminate a transmission if we have */
     inhibit();
@@ -125,6 +137,9 @@ uint8_t ps2_host_send(uint8_t data)
     PS2_USART_RX_INT_ON();
     return ps2_host_recv_response();
 ERROR:
+#ifdef PS2_RECV_DEVICE
+    recv_response = false;
+#endif
     idle();
     PS2_USART_INIT();
     PS2_USART_RX_INT_ON();
@@ -134,9 +149,20 @@ ERROR:
 uint8_t ps2_host_recv_response(void)
 {
     // Command may take 25ms/20ms at most([5]p.46, [3]p.21)
-    uint8_t retry = 25;
+    // 250 * 100us, shorter than a frame so that next byte goes to device decoder
+    uint8_t retry = 250;
+#ifdef PS2_RECV_DEVICE
+    recv_response = true;
+#endif
     while (retry-- && !pbuf_has_data()) {
-        _delay_ms(1);
+        _delay_us(100);
+    }
+#ifdef PS2_RECV_DEVICE
+    recv_response = false;
+#endif
+    if (!pbuf_has_data()) {
+        ps2_error = PS2_ERR_NODATA;
+        return 0;
     }
     return pbuf_dequeue();
 }
@@ -152,14 +178,33 @@ uint8_t ps2_host_recv(void)
     }
 }
 
+bool ps2_host_recv_failed(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    bool failed = recv_failed;
+    recv_failed = false;
+    SREG = sreg;
+    return failed;
+}
+
 ISR(PS2_USART_RX_VECT)
 {
-    // TODO: request RESEND when error occurs?
     uint8_t error = PS2_USART_ERROR;    // USART error should be read before data
     uint8_t data = PS2_USART_RX_DATA;
     if (!error) {
+#ifdef PS2_RECV_DEVICE
+        if (!recv_response) {
+            PS2_RECV_DEVICE(data);
+            return;
+        }
+#endif
         pbuf_enqueue(data);
     } else {
+        if (error & PS2_USART_ERROR_PARITY) ps2_error_count.parity++;
+        if (error & PS2_USART_ERROR_OVERRUN) ps2_error_count.overflow++;
+        if (error & PS2_USART_ERROR_FRAME) ps2_error_count.frame++;
+        recv_failed = true;
         xprintf("PS2 USART error: %02X data: %02X\n", error, data);
     }
 }
@@ -188,6 +233,7 @@ static inline void pbuf_enqueue(uint8_t data)
         pbuf[pbuf_head] = data;
         pbuf_head = next;
     } else {
+        ps2_error_count.overflow++;
         print("pbuf: full\n");
     }
     SREG = sreg;
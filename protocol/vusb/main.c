@@ -95,6 +95,7 @@ int main(void)
                 keyboard_task();
             }
             vusb_transfer_keyboard();
+            vusb_transfer_mouse();
         }
     }
 }
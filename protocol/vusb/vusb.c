@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <util/delay.h>
 #include "usbdrv.h"
 #include "usbconfig.h"
 #include "host.h"
@@ -35,13 +36,10 @@ static report_keyboard_t kbuf[KBUF_SIZE];
 static uint8_t kbuf_head = 0;
 static uint8_t kbuf_tail = 0;
 
-typedef struct {
-        uint8_t modifier;
-        uint8_t reserved;
-        uint8_t keycode[6];
-} keyboard_report_t;
+static report_keyboard_t keyboard_report; // sent to PC
 
-static keyboard_report_t keyboard_report; // sent to PC
+/* Mouse reports not sent yet as interrupt endpoint 3 was busy */
+static report_mouse_queue_t mouse_queue;
 
 /* transfer keyboard report from buffer */
 void vusb_transfer_keyboard(void)
@@ -49,6 +47,7 @@ void vusb_transfer_keyboard(void)
     if (usbInterruptIsReady()) {
         if (kbuf_head != kbuf_tail) {
             usbSetInterrupt((void *)&kbuf[kbuf_tail], sizeof(report_keyboard_t));
+            keyboard_report = kbuf[kbuf_tail];
             kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
             if (debug_keyboard) {
                 print("V-USB: kbuf["); pdec(kbuf_tail); print("->"); pdec(kbuf_head); print("](");
@@ -86,10 +85,25 @@ static uint8_t keyboard_leds(void) {
     return vusb_keyboard_leds;
 }
 
+/* merge report into newest one in buffer when host can't tell the difference */
+static bool kbuf_merge(report_keyboard_t *report)
+{
+    if (kbuf_head == kbuf_tail) return false;
+
+    uint8_t last = (kbuf_head + KBUF_SIZE - 1) % KBUF_SIZE;
+    report_keyboard_t *prev = (last == kbuf_tail) ? &keyboard_report : &kbuf[(last + KBUF_SIZE - 1) % KBUF_SIZE];
+    if (!report_keyboard_mergeable(prev, &kbuf[last], report, false)) return false;
+
+    kbuf[last] = *report;
+    return true;
+}
+
 static void send_keyboard(report_keyboard_t *report)
 {
     uint8_t next = (kbuf_head + 1) % KBUF_SIZE;
-    if (next != kbuf_tail) {
+    if (kbuf_merge(report)) {
+        // merged
+    } else if (next != kbuf_tail) {
         kbuf[kbuf_head] = *report;
         kbuf_head = next;
     } else {
@@ -107,17 +121,39 @@ typedef struct {
     report_mouse_t report;
 } __attribute__ ((packed)) vusb_mouse_report_t;
 
-static void send_mouse(report_mouse_t *report)
+/* transfer pending mouse report */
+void vusb_transfer_mouse(void)
 {
-    vusb_mouse_report_t r = {
-        .report_id = REPORT_ID_MOUSE,
-        .report = *report
-    };
-    if (usbInterruptIsReady3()) {
+    if (mouse_queue.count && usbInterruptIsReady3()) {
+        vusb_mouse_report_t r = {
+            .report_id = REPORT_ID_MOUSE,
+            .report = mouse_queue.report[0]
+        };
         usbSetInterrupt3((void *)&r, sizeof(vusb_mouse_report_t));
+        report_mouse_sent(&mouse_queue);
     }
 }
 
+static void send_mouse(report_mouse_t *report)
+{
+    uint8_t timeout = 255;
+
+    /* Add motion to reports not sent yet. When both of them have button change
+     * poll USB for one to be sent for a polling interval around 10ms, then give
+     * up motion of this report but not its buttons. */
+    while (!report_mouse_put(&mouse_queue, report)) {
+        if (!timeout--) {
+            mouse_queue.report[1].buttons = report->buttons;
+            break;
+        }
+        usbPoll();
+        vusb_transfer_mouse();
+        if (mouse_queue.count == 2) _delay_us(40);
+    }
+
+    vusb_transfer_mouse();
+}
+
 
 typedef struct {
     uint8_t  report_id;
@@ -4,6 +4,7 @@ OBJECTS += \
 	$(OBJDIR)/common/action_macro.o \
 	$(OBJDIR)/common/action_layer.o \
 	$(OBJDIR)/common/action_util.o \
+	$(OBJDIR)/common/report.o \
 	$(OBJDIR)/common/host.o \
 	$(OBJDIR)/common/keymap.o \
 	$(OBJDIR)/common/keyboard.o \
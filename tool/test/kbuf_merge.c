@@ -0,0 +1,222 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Keyboard report coalescing of V-USB kbuf(protocol/vusb/vusb.c)
+ *
+ * Order rules of report_keyboard_mergeable() are checked on single cases,
+ * then random macro traces are sent through send_keyboard and kbuf_merge
+ * while host polls at random. A host model applies reports received as
+ * host does, modifiers first, then releases, then presses, and key sequence
+ * it sees must be the same as with every report sent as it is.
+ */
+#define PROTOCOL_VUSB
+#include "../../protocol/vusb/vusb.c"
+#include "../../common/report.c"
+#include "../../common/util.c"
+#include "../../common/debug.c"
+
+const uchar *usbMsgPtr;
+
+
+/*
+ * Host model
+ */
+typedef struct {
+    report_keyboard_t state;
+    uint16_t transitions[256 + 8];  // per key and modifier bit
+    uint32_t presses[4096];         // code, mods and keys held at each press
+    int npresses;
+} host_t;
+
+static uint32_t held_hash(report_keyboard_t *r)
+{
+    uint32_t h = 0;
+    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (r->keys[i]) h += r->keys[i] * 2654435761u;
+    }
+    return h;
+}
+
+static bool has_key(report_keyboard_t *r, uint8_t code)
+{
+    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (r->keys[i] == code) return true;
+    }
+    return false;
+}
+
+static void host_receive(host_t *host, report_keyboard_t *r)
+{
+    report_keyboard_t *s = &host->state;
+
+    for (int b = 0; b < 8; b++) {
+        if ((s->mods ^ r->mods) & (1<<b)) host->transitions[256 + b]++;
+    }
+    s->mods = r->mods;
+
+    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (s->keys[i] && !has_key(r, s->keys[i])) {
+            host->transitions[s->keys[i]]++;
+            s->keys[i] = 0;
+        }
+    }
+    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        uint8_t code = r->keys[i];
+        if (code && !has_key(s, code)) {
+            host->transitions[code]++;
+            if (host->npresses < 4096) {
+                host->presses[host->npresses++] = (code | s->mods<<8) ^ held_hash(s);
+            }
+            for (int j = 0; j < KEYBOARD_REPORT_KEYS; j++) {
+                if (!s->keys[j]) { s->keys[j] = code; break; }
+            }
+        }
+    }
+}
+
+static host_t direct, queued;
+
+
+/*
+ * V-USB interrupt endpoint: host polls at random
+ */
+static int poll_percent = 50;
+static int sent = 0;
+
+void usbPoll(void) {}
+bool usbInterruptIsReady(void) { return rand() % 100 < poll_percent; }
+bool usbInterruptIsReady3(void) { return true; }
+void usbSetInterrupt3(uchar *data, uchar len) { (void)data; (void)len; }
+void usbSetInterrupt(uchar *data, uchar len)
+{
+    (void)len;
+    host_receive(&queued, (report_keyboard_t *)data);
+    sent++;
+}
+
+static void drain(void)
+{
+    int p = poll_percent;
+    poll_percent = 100;
+    while (kbuf_head != kbuf_tail) vusb_transfer_keyboard();
+    poll_percent = p;
+}
+
+
+/*
+ * Macro trace: random presses, releases and modifier changes
+ */
+static void send(report_keyboard_t *r)
+{
+    host_receive(&direct, r);
+    /* host polls eventually, not to lose report in full kbuf */
+    if ((kbuf_head + 1) % KBUF_SIZE == kbuf_tail) {
+        int p = poll_percent;
+        poll_percent = 100;
+        vusb_transfer_keyboard();
+        poll_percent = p;
+    }
+    report_keyboard_t copy = *r;
+    send_keyboard(&copy);
+}
+
+static void trace(int steps)
+{
+    report_keyboard_t r = {};
+    for (int i = 0; i < steps; i++) {
+        int op = rand() % 3;
+        if (op == 0) {
+            r.mods ^= 1 << (rand() % 4);
+        } else {
+            uint8_t code = KC_A + rand() % 8;
+            int slot = -1;
+            for (int j = 0; j < KEYBOARD_REPORT_KEYS; j++) {
+                if (r.keys[j] == code) slot = j;
+            }
+            if (slot >= 0) {
+                r.keys[slot] = 0;
+            } else {
+                for (int j = 0; j < KEYBOARD_REPORT_KEYS; j++) {
+                    if (!r.keys[j]) { r.keys[j] = code; break; }
+                }
+            }
+        }
+        send(&r);
+    }
+    r = (report_keyboard_t){};
+    send(&r);
+    drain();
+}
+
+
+/* single merge cases, reports are built from prev */
+static bool mergeable(uint8_t prev_key, uint8_t prev_mods,
+                      uint8_t queued_key, uint8_t queued_mods,
+                      uint8_t key, uint8_t mods)
+{
+    report_keyboard_t p = { .mods = prev_mods, .keys = { prev_key } };
+    report_keyboard_t q = { .mods = queued_mods, .keys = { queued_key } };
+    report_keyboard_t r = { .mods = mods, .keys = { key } };
+    return report_keyboard_mergeable(&p, &q, &r, false);
+}
+
+int main(void)
+{
+    const uint8_t A = KC_A, B = KC_B, S = MOD_BIT(KC_LSHIFT), C = MOD_BIT(KC_LCTRL);
+
+    CHECK(mergeable(0, 0,  0, S,  0, S|C), "modifier changes merge");
+    CHECK(!mergeable(0, 0,  0, S,  0, 0), "modifier tap doesn't merge");
+    CHECK(!mergeable(0, 0,  A, 0,  0, 0), "key tap doesn't merge");
+    CHECK(!mergeable(A, 0,  0, 0,  A, 0), "key release and press doesn't merge");
+    CHECK(mergeable(0, 0,  0, S,  A, S), "modifier then press merges");
+    CHECK(!mergeable(0, 0,  A, 0,  A, S), "press then modifier doesn't merge");
+    CHECK(mergeable(A, 0,  0, 0,  B, 0), "release then press merges");
+    {
+        report_keyboard_t p = { .keys = { B } };
+        report_keyboard_t q = { .keys = { B, A } };
+        report_keyboard_t r = { .keys = { A } };
+        CHECK(!report_keyboard_mergeable(&p, &q, &r, false), "press then release doesn't merge");
+    }
+    {
+        report_keyboard_t p = {};
+        report_keyboard_t q = { .keys = { A } };
+        report_keyboard_t r = { .keys = { A, B } };
+        CHECK(!report_keyboard_mergeable(&p, &q, &r, false), "two presses don't merge");
+    }
+
+    srand(1);
+    int reports = 0;
+    for (int n = 0; n < 20000 && !test_failed; n++) {
+        memset(&direct, 0, sizeof(direct));
+        memset(&queued, 0, sizeof(queued));
+        poll_percent = 10 + rand() % 80;
+        trace(40);
+        reports += 41;
+
+        CHECK(memcmp(direct.transitions, queued.transitions, sizeof(direct.transitions)) == 0,
+              "trace %d: transitions of keys or modifiers differ", n);
+        CHECK(direct.npresses == queued.npresses &&
+              memcmp(direct.presses, queued.presses, direct.npresses * sizeof(uint32_t)) == 0,
+              "trace %d: presses differ", n);
+        CHECK(memcmp(&direct.state, &queued.state, sizeof(report_keyboard_t)) == 0,
+              "trace %d: final state differs", n);
+    }
+    printf("%d reports queued, %d sent after merge\n", reports, sent);
+
+    return TEST_RESULT();
+}
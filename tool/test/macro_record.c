@@ -0,0 +1,276 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Macro recording of action_macro_record.c saved to simulated EEPROM
+ *
+ * Random key events with random time between them are recorded, saved to
+ * EEPROM(stub/avr/eeprom.h) and played back by action_macro.c. Every keycode
+ * from KC_A to KC_EXSEL and modifiers are recorded, also 0x74-0xA4 which
+ * don't have one byte command. Recording that fits must play back the same
+ * events and time between them, one that doesn't must still be valid macro
+ * which releases all keys it presses.
+ */
+#define MACRO_RECORD_ENABLE
+#define MACRO_RECORD_EEPROM
+#define BOOTMAGIC_ENABLE
+#include "../../common/action_macro_record.c"
+#include "../../common/action_macro.c"
+
+static uint16_t now;
+uint16_t timer_read(void) { return now; }
+uint16_t timer_elapsed(uint16_t last) { return now - last; }
+
+
+/*
+ * Events played: keycode | 0x100 when pressed, and time
+ */
+#define EVENTS_MAX  1024
+static uint16_t played[EVENTS_MAX];
+static uint16_t played_time[EVENTS_MAX];
+static int nplayed;
+
+static void play_event(uint8_t code, bool pressed)
+{
+    if (nplayed < EVENTS_MAX) {
+        played[nplayed] = code | (pressed ? 0x100 : 0);
+        played_time[nplayed] = now;
+        nplayed++;
+    }
+}
+
+void register_code(uint8_t code) { play_event(code, true); }
+void unregister_code(uint8_t code) { play_event(code, false); }
+void add_weak_mods(uint8_t mods)
+{
+    for (uint8_t i = 0; i < 8; i++) if (mods & (1<<i)) play_event(KC_LCTRL + i, true);
+}
+void del_weak_mods(uint8_t mods)
+{
+    for (uint8_t i = 0; i < 8; i++) if (mods & (1<<i)) play_event(KC_LCTRL + i, false);
+}
+/* used by text typing only */
+void add_key(uint8_t code) { (void)code; }
+void del_key(uint8_t code) { (void)code; }
+void clear_keys(void) {}
+uint8_t has_anykey(void) { return 0; }
+void send_keyboard_report(void) {}
+
+
+/*
+ * Recording
+ */
+static uint16_t input[EVENTS_MAX];
+static uint16_t input_time[EVENTS_MAX];
+static int ninput;
+
+static void record(uint8_t code, bool pressed, uint16_t gap)
+{
+    now += gap;
+    input[ninput] = code | (pressed ? 0x100 : 0);
+    input_time[ninput] = now;
+    ninput++;
+    if (IS_MOD(code))
+        action_macro_record_mods(MOD_BIT(code), pressed);
+    else
+        action_macro_record_key(code, pressed);
+}
+
+static uint8_t random_code(void)
+{
+    switch (rand() % 4) {
+        case 0:  return 0x74 + rand() % (KC_EXSEL - 0x74 + 1);
+        case 1:  return KC_LCTRL + rand() % 8;
+        default: return KC_A + rand() % (KC_EXSEL - KC_A + 1);
+    }
+}
+
+static uint16_t random_gap(void)
+{
+    switch (rand() % 4) {
+        case 0:  return 0;
+        case 1:  return 256 + rand() % 1000;
+        default: return 1 + rand() % 255;
+    }
+}
+
+/* records random events, all keys are released at the end when 'release' */
+static void record_random(uint8_t slot, int events, bool release)
+{
+    uint8_t held[MACRO_RECORD_KEYS];
+    uint8_t nheld = 0;
+
+    ninput = 0;
+    action_macro_record(slot);
+    for (int i = 0; i < events; i++) {
+        if (nheld && (nheld == MACRO_RECORD_KEYS || rand() % 2)) {
+            uint8_t k = rand() % nheld;
+            record(held[k], false, random_gap());
+            held[k] = held[--nheld];
+        } else {
+            uint8_t code;
+            bool dup;
+            do {
+                code = random_code();
+                dup = false;
+                for (uint8_t k = 0; k < nheld; k++) if (held[k] == code) dup = true;
+            } while (dup);
+            record(code, true, random_gap());
+            held[nheld++] = code;
+        }
+    }
+    while (release && nheld) {
+        record(held[--nheld], false, random_gap());
+    }
+    now += random_gap();
+    action_macro_record(slot);
+}
+
+/* worst case bytes of recording when nothing is dropped */
+static int input_size(void)
+{
+    int size = 1;
+    for (int i = 0; i < ninput; i++) {
+        uint8_t code = input[i] & 0xFF;
+        size += (i && input_time[i] != input_time[i - 1] ? 2 : 0);
+        size += (code <= 0x73 ? 1 : 2);
+    }
+    return size;
+}
+
+static void play(uint8_t slot)
+{
+    nplayed = 0;
+    now += 1000;
+    action_macro_record(slot | MACRO_RECORD_PLAY);
+    while (action_macro_playing()) {
+        now++;
+        action_macro_task();
+    }
+}
+
+
+/* macro saved in EEPROM has only valid commands and fits in slot */
+static void check_stream(uint8_t slot)
+{
+    uint8_t *p = &eeprom_sim[(uintptr_t)EECONFIG_MACRO_RECORD + slot * MACRO_RECORD_SIZE];
+    int i = 0;
+    while (i < MACRO_RECORD_SIZE) {
+        uint8_t c = p[i++];
+        if (c == END) return;
+        if (c == KEY_DOWN || c == KEY_UP || c == WAIT) {
+            i++;
+        } else if (!((c >= 0x04 && c <= 0x73) || (c >= 0x84 && c <= 0xF3))) {
+            CHECK(false, "slot %u: invalid command %02X at %d", slot, c, i - 1);
+            return;
+        }
+    }
+    CHECK(false, "slot %u: no END in %d bytes", slot, MACRO_RECORD_SIZE);
+}
+
+static void check_exact(uint8_t slot)
+{
+    CHECK(nplayed == ninput, "slot %u: %d events played, %d recorded", slot, nplayed, ninput);
+    for (int i = 0; i < ninput && i < nplayed; i++) {
+        CHECK(played[i] == input[i], "slot %u event %d: played %03X recorded %03X", slot, i, played[i], input[i]);
+        if (played[i] != input[i]) break;
+        if (i == 0) continue;
+        uint16_t gap = input_time[i] - input_time[i - 1];
+        uint16_t expect = (gap > 255 ? 255 : gap);
+        uint16_t wait = played_time[i] - played_time[i - 1];
+        CHECK(wait == expect, "slot %u event %d: wait %u expected %u", slot, i, wait, expect);
+    }
+}
+
+/* played events are recorded ones, some dropped, and keys are all released */
+static void check_consistent(uint8_t slot)
+{
+    bool down[256] = {};
+    int j = 0;
+    for (int i = 0; i < nplayed; i++) {
+        uint8_t code = played[i] & 0xFF;
+        bool pressed = played[i] & 0x100;
+        CHECK(down[code] != pressed, "slot %u event %d: %03X twice", slot, i, played[i]);
+        down[code] = pressed;
+        if (pressed) {
+            while (j < ninput && input[j] != played[i]) j++;
+            CHECK(j < ninput, "slot %u event %d: %03X not recorded", slot, i, played[i]);
+            j++;
+        }
+    }
+    for (int code = 0; code < 256; code++) {
+        CHECK(!down[code], "slot %u: %02X left pressed", slot, code);
+    }
+}
+
+int main(void)
+{
+    /* every key and modifier pressed and released alone */
+    for (int code = KC_A; code <= KC_RGUI; code++) {
+        if (code > KC_EXSEL && code < KC_LCTRL) continue;
+        ninput = 0;
+        action_macro_record(0);
+        record(code, true, 0);
+        record(code, false, 100);
+        action_macro_record(0);
+        check_stream(0);
+        play(0);
+        check_exact(0);
+    }
+
+    /* KC_INT1(0x87) was played back as UP(0x07) */
+    ninput = 0;
+    action_macro_record(1);
+    record(KC_INT1, true, 0);
+    record(KC_A, true, 10);
+    record(KC_INT1, false, 10);
+    record(KC_A, false, 10);
+    action_macro_record(1);
+    check_stream(1);
+    play(1);
+    check_exact(1);
+
+    srand(1);
+    int exact = 0, overflow = 0;
+    for (int i = 0; i < 20000; i++) {
+        uint8_t slot = rand() % MACRO_RECORD_SLOTS;
+        bool release = rand() % 4;
+        record_random(slot, 1 + rand() % 40, release);
+        check_stream(slot);
+        play(slot);
+        if (release && input_size() <= MACRO_RECORD_SIZE) {
+            check_exact(slot);
+            exact++;
+        } else {
+            check_consistent(slot);
+            overflow++;
+        }
+        if (test_failed) break;
+    }
+    printf("%d recordings played exactly, %d full or with keys held\n", exact, overflow);
+
+    /* slots don't overwrite each other */
+    record_random(0, 6, true);
+    int n0 = ninput;
+    uint16_t in0[EVENTS_MAX];
+    memcpy(in0, input, sizeof(in0));
+    record_random(1, 10, true);
+    play(0);
+    CHECK(nplayed == n0 && memcmp(played, in0, n0 * sizeof(played[0])) == 0, "slot 0 changed by slot 1");
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,127 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Mouse report queue of report.c through V-USB send_mouse(protocol/vusb/vusb.c)
+ *
+ * Random motion and button changes are sent while host polls at random. Host
+ * must see every button change in order and the same total motion as with
+ * every report sent as it is. With endpoint stuck, the first button change
+ * still goes out and buttons end up as sent last.
+ */
+#define PROTOCOL_VUSB
+#include "../../protocol/vusb/vusb.c"
+#include "../../common/report.c"
+#include "../../common/util.c"
+#include "../../common/debug.c"
+
+const uchar *usbMsgPtr;
+
+
+/*
+ * Host model: button changes and total motion
+ */
+#define CHANGES_MAX 4096
+typedef struct {
+    uint8_t buttons;
+    uint8_t changes[CHANGES_MAX];
+    int nchanges;
+    long x, y, v, h;
+} host_t;
+
+static void host_receive(host_t *host, report_mouse_t *r)
+{
+    if (r->buttons != host->buttons && host->nchanges < CHANGES_MAX)
+        host->changes[host->nchanges++] = r->buttons;
+    host->buttons = r->buttons;
+    host->x += r->x; host->y += r->y;
+    host->v += r->v; host->h += r->h;
+}
+
+static host_t direct, queued;
+
+
+/*
+ * V-USB interrupt endpoint 3: host polls at random
+ */
+static int poll_percent = 50;
+
+void usbPoll(void) {}
+bool usbInterruptIsReady(void) { return true; }
+void usbSetInterrupt(uchar *data, uchar len) { (void)data; (void)len; }
+bool usbInterruptIsReady3(void) { return rand() % 100 < poll_percent; }
+void usbSetInterrupt3(uchar *data, uchar len)
+{
+    (void)len;
+    host_receive(&queued, &((vusb_mouse_report_t *)data)->report);
+}
+
+static void drain(void)
+{
+    int p = poll_percent;
+    poll_percent = 100;
+    while (mouse_queue.count) vusb_transfer_mouse();
+    poll_percent = p;
+}
+
+static void send(report_mouse_t *r)
+{
+    host_receive(&direct, r);
+    send_mouse(r);
+}
+
+static int8_t small(void) { return rand() % 7 - 3; }
+
+
+int main(void)
+{
+    srand(1);
+
+    /* button changes and motion with host polling at random */
+    uint8_t buttons = 0;
+    for (int i = 0; i < 100000; i++) {
+        if (rand() % 4 == 0) buttons ^= 1 << (rand() % 3);
+        report_mouse_t r = { .buttons = buttons, .x = small(), .y = small(), .v = small(), .h = small() };
+        send(&r);
+        if (rand() % 8 == 0) vusb_transfer_mouse();
+        if (direct.nchanges >= CHANGES_MAX - 8) break;
+    }
+    drain();
+    CHECK(queued.nchanges == direct.nchanges, "%d button changes, %d sent", queued.nchanges, direct.nchanges);
+    CHECK(memcmp(queued.changes, direct.changes, direct.nchanges) == 0, "button changes differ");
+    CHECK(queued.x == direct.x && queued.y == direct.y, "x y %ld %ld, %ld %ld sent", queued.x, queued.y, direct.x, direct.y);
+    CHECK(queued.v == direct.v && queued.h == direct.h, "v h %ld %ld, %ld %ld sent", queued.v, queued.h, direct.v, direct.h);
+    printf("%d button changes\n", direct.nchanges);
+
+    /* endpoint stuck: press goes out first, release and press again are
+     * squashed into buttons sent last and motion of the last press is lost */
+    send(&(report_mouse_t){ .buttons = 0 });
+    drain();
+    memset(&queued, 0, sizeof(queued));
+    poll_percent = 0;
+    send(&(report_mouse_t){ .buttons = 0, .x = 5 });
+    send(&(report_mouse_t){ .buttons = 1, .x = 5 });
+    send(&(report_mouse_t){ .buttons = 0, .x = 5 });
+    send(&(report_mouse_t){ .buttons = 1, .x = 5 });
+    send(&(report_mouse_t){ .buttons = 1, .x = 5 });
+    drain();
+    CHECK(queued.nchanges >= 1 && queued.changes[0] == 1, "press lost while endpoint stuck");
+    CHECK(queued.buttons == 1, "buttons %02X after endpoint stuck", queued.buttons);
+    CHECK(queued.x == 20, "x %ld after endpoint stuck", queued.x);
+
+    return TEST_RESULT();
+}
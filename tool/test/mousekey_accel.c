@@ -0,0 +1,137 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fixed-point mousekey acceleration of mousekey.c
+ *
+ * Checks ramp() from log2/exp2 tables against pow() for every mk_curve and
+ * ramp position, mul_q16() against 64-bit product, and that diagonal move
+ * is 1/sqrt(2) of straight one and does not depend on mk_interval.
+ */
+#include <math.h>
+#include "../../common/mousekey.c"
+
+static uint16_t now;
+uint16_t timer_read(void) { return now; }
+uint16_t timer_elapsed(uint16_t last) { return now - last; }
+uint8_t host_mouse_wheel_multiplier_v(void) { return 1; }
+uint8_t host_mouse_wheel_multiplier_h(void) { return 1; }
+
+static long sum_x, sum_y;
+void host_mouse_send(report_mouse_t *report)
+{
+    sum_x += report->x;
+    sum_y += report->y;
+}
+
+
+/* ramp() on 1/256 steps of ramp time, so that error is of tables only */
+static void test_ramp(void)
+{
+    double max_err = 0;
+    for (int c = -100; c <= 100; c++) {
+        mk_curve = c;
+        for (uint16_t t = 1; t <= 256; t++) {
+            double expect = 256 * pow(t / 256.0, (100 + c) / 100.0);
+            double err = fabs(ramp(t, 256) - expect);
+            if (err > max_err) max_err = err;
+            CHECK(err <= 1.0, "ramp(%u/256) curve %d: %u expected %.2f", t, c, ramp(t, 256), expect);
+        }
+    }
+    printf("ramp: max error %.3f/256\n", max_err);
+
+    /* linear curve and ends are exact */
+    mk_curve = 0;
+    for (uint16_t time = MOUSEKEY_INTERVAL; time <= UINT8_MAX * MOUSEKEY_INTERVAL; time += MOUSEKEY_INTERVAL) {
+        for (uint16_t t = 0; t <= time + MOUSEKEY_INTERVAL; t += MOUSEKEY_INTERVAL) {
+            uint16_t expect = (t >= time ? 256 : ((uint32_t)t << 8) / time);
+            CHECK(ramp(t, time) == expect, "linear ramp(%u, %u): %u expected %u", t, time, ramp(t, time), expect);
+        }
+    }
+    for (int c = -100; c <= 100; c += 10) {
+        mk_curve = c;
+        CHECK(ramp(0, 1000) == 0, "ramp start curve %d: %u", c, ramp(0, 1000));
+        CHECK(ramp(1000, 1000) == 256, "ramp end curve %d: %u", c, ramp(1000, 1000));
+    }
+    mk_curve = MOUSEKEY_CURVE;
+}
+
+static void test_mul_q16(void)
+{
+    srand(1);
+    for (long n = 0; n < 1000000; n++) {
+        uint32_t a = (uint32_t)rand() << 16 ^ rand();
+        uint16_t b = (n & 1 ? 46341 : rand());
+        uint32_t expect = ((uint64_t)a * b) >> 16;
+        uint32_t got = mul_q16(a, b);
+        CHECK(got == expect || got + 1 == expect, "mul_q16(%u, %u): %u expected %u", a, b, got, expect);
+    }
+}
+
+/* distance after holding keys for 'ms' */
+static void hold(uint8_t k1, uint8_t k2, uint16_t ms)
+{
+    sum_x = sum_y = 0;
+    mousekey_clear();
+    mousekey_on(k1);
+    if (k2) mousekey_on(k2);
+    mousekey_send();
+    for (uint16_t t = 0; t < ms; t++) {
+        now++;
+        mousekey_task();
+    }
+    mousekey_clear();
+}
+
+static void test_diagonal(void)
+{
+    static const uint8_t intervals[] = { 10, 20, 50 };
+    long straight50 = 0;
+    for (uint8_t i = 0; i < sizeof(intervals); i++) {
+        mk_interval = intervals[i];
+        for (uint16_t ms = 1000; ms <= 3000; ms += 500) {
+            hold(KC_MS_RIGHT, 0, ms);
+            long straight = sum_x;
+            CHECK(sum_y == 0, "straight y: %ld", sum_y);
+            hold(KC_MS_RIGHT, KC_MS_DOWN, ms);
+            CHECK(sum_x == sum_y, "diagonal x %ld y %ld", sum_x, sum_y);
+            double ratio = (double)sum_x / straight;
+            CHECK(fabs(ratio - M_SQRT1_2) < 0.01, "diagonal %ldms interval %u: %ld/%ld = %.4f",
+                  (long)ms, mk_interval, sum_x, straight, ratio);
+            if (ms == 3000) {
+                if (mk_interval == 50) straight50 = straight;
+                printf("interval %2u: 3s straight %ld diagonal %ld\n", mk_interval, straight, sum_x);
+            }
+        }
+    }
+    /* 10ms and 20ms runs end within one report of 50ms distance */
+    for (uint8_t i = 0; i < sizeof(intervals); i++) {
+        mk_interval = intervals[i];
+        hold(KC_MS_RIGHT, 0, 3000);
+        CHECK(labs(sum_x - straight50) <= MOUSEKEY_MAX_SPEED * MOUSEKEY_MOVE_DELTA,
+              "interval %u: %ld vs %ld", mk_interval, sum_x, straight50);
+    }
+    mk_interval = MOUSEKEY_INTERVAL;
+}
+
+int main(void)
+{
+    test_ramp();
+    test_mul_q16();
+    test_diagonal();
+    return TEST_RESULT();
+}
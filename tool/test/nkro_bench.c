@@ -0,0 +1,151 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * NKRO key count and lowest key of action_util.c against bitmap scan
+ *
+ * Checks has_anykey() and get_first_key() with random press/release on the
+ * 15-byte bitmap of LUFA NKRO report(NKRO_EPSIZE 16), and times them against
+ * the scans they replaced, called after each change as send_keyboard_report
+ * does.
+ */
+#define PROTOCOL_LUFA
+#define NKRO_ENABLE
+#include <time.h>
+#include "../../common/action_util.c"
+#include "../../common/util.c"
+
+bool keyboard_nkro = true;
+void host_keyboard_send(report_keyboard_t *report) { (void)report; }
+uint16_t timer_read(void) { return 0; }
+
+
+/* scans before incremental count */
+static uint8_t scan_anykey(void)
+{
+    uint8_t cnt = 0;
+    for (uint8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
+        if (keyboard_report->raw[i])
+            cnt++;
+    }
+    return cnt;
+}
+
+static uint8_t scan_first_key(void)
+{
+    uint8_t i = 0;
+    for (; i < KEYBOARD_REPORT_BITS && !keyboard_report->nkro.bits[i]; i++)
+        ;
+    return i<<3 | biton(keyboard_report->nkro.bits[i]);
+}
+
+/* keys on and lowest of them by brute force */
+static uint8_t count_bits(uint8_t *first)
+{
+    uint8_t cnt = 0;
+    *first = 0;
+    for (int code = KEYBOARD_REPORT_BITS*8 - 1; code >= 0; code--) {
+        if (keyboard_report->nkro.bits[code>>3] & (1<<(code&7))) {
+            cnt++;
+            *first = code;
+        }
+    }
+    return cnt;
+}
+
+#define STEPS   2000000
+#define KEYS    16      // keys held at most, like fast typing and rolls
+
+static uint8_t seq[STEPS];
+static bool seq_press[STEPS];
+
+/* random sequence with few keys held at a time */
+static void make_seq(void)
+{
+    uint8_t held[KEYS];
+    uint8_t n = 0;
+    for (int i = 0; i < STEPS; i++) {
+        if (n && (n == KEYS || rand() % 2)) {
+            uint8_t j = rand() % n;
+            seq[i] = held[j];
+            seq_press[i] = false;
+            held[j] = held[--n];
+        } else {
+            uint8_t code;
+            do {
+                code = KC_A + rand() % (KEYBOARD_REPORT_BITS*8 - KC_A);
+                for (uint8_t j = 0; j < n; j++) {
+                    if (held[j] == code) code = 0;
+                }
+            } while (!code);
+            seq[i] = code;
+            seq_press[i] = true;
+            held[n++] = code;
+        }
+    }
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    srand(1);
+    make_seq();
+
+    /* correctness */
+    clear_keys();
+    for (int i = 0; i < STEPS; i++) {
+        if (seq_press[i]) add_key(seq[i]); else del_key(seq[i]);
+        uint8_t first;
+        uint8_t cnt = count_bits(&first);
+        CHECK(has_anykey() == cnt, "step %d: count %u != %u", i, has_anykey(), cnt);
+        CHECK(get_first_key() == first, "step %d: first %02X != %02X", i, get_first_key(), first);
+        if (test_failed > 10) break;
+    }
+    /* duplicate press and release of key not on are no-op */
+    clear_keys();
+    add_key(KC_B); add_key(KC_B); add_key(KC_A);
+    del_key(KC_C); del_key(KC_A); del_key(KC_A);
+    CHECK(has_anykey() == 1 && get_first_key() == KC_B, "duplicate: %u %02X", has_anykey(), get_first_key());
+    clear_keys();
+    CHECK(has_anykey() == 0 && get_first_key() == 0, "clear: %u %02X", has_anykey(), get_first_key());
+
+    /* benchmark */
+    volatile uint8_t sink = 0;
+    double t0 = now();
+    clear_keys();
+    for (int i = 0; i < STEPS; i++) {
+        if (seq_press[i]) add_key(seq[i]); else del_key(seq[i]);
+        sink += has_anykey() + get_first_key();
+    }
+    double t1 = now();
+    clear_keys();
+    for (int i = 0; i < STEPS; i++) {
+        if (seq_press[i]) add_key(seq[i]); else del_key(seq[i]);
+        sink += scan_anykey() + scan_first_key();
+    }
+    double t2 = now();
+    printf("%d steps, %d-byte bitmap: incremental %.1f ns/step, scan %.1f ns/step\n",
+           STEPS, KEYBOARD_REPORT_BITS, (t1 - t0) * 1e9 / STEPS, (t2 - t1) * 1e9 / STEPS);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,578 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * PS/2 line simulator for tests of PS/2 drivers with ps2_kbd.c
+ *
+ * Clock and data are open collector lines, low while host or device pulls
+ * them, and host side of ps2_io.h is implemented here. Time is counted in
+ * microseconds and runs only in waits: wait_us/wait_ms and _delay_us/
+ * _delay_ms of driver and sim_wait() of test. On every microsecond the
+ * keyboard model takes its step and pending interrupt handler runs.
+ *
+ * PS2_USE_INT: falling clock edge sets interrupt flag and PS2_INT_VECT runs
+ * while it is enabled with PS2_INT_ON and in SREG, as INT1 of AVR.
+ * PS2_USE_USART: falling clock edge shifts data line into receiver which
+ * gives byte with FE, DOR and UPE, as USART of AVR in synchronous slave
+ * mode, and PS2_USART_RX_VECT runs while received byte is unread.
+ * PS2_USE_BUSYWAIT: driver polls lines in its waits.
+ *
+ * Test defines one of them and includes this, which includes the driver and
+ * ps2_kbd.c, then runs ps2_line_test().
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+static uint32_t sim_us;
+static void sim_wait(uint32_t us);
+
+#define WAIT_H
+#define wait_us(us)     sim_wait(us)
+#define wait_ms(ms)     sim_wait((uint32_t)(ms) * 1000)
+#define _delay_us(us)   sim_wait(us)
+#define _delay_ms(ms)   sim_wait((uint32_t)(ms) * 1000)
+
+/* Timer0 of timer.c on 16MHz: 4us count, compare match at TIMER_RAW_TOP */
+#define TIMER_RAW_FREQ  250000
+#define TIMER_RAW_TOP   (TIMER_RAW_FREQ / 1000)
+#define TIMER_RAW       ((uint8_t)(sim_us / 4 % (TIMER_RAW_TOP + 1)))
+volatile uint32_t timer_count;
+uint16_t timer_read(void) { return timer_count; }
+
+#define PS2_KBD_ENABLE
+
+
+/*
+ * Lines
+ */
+static bool host_clock_lo, host_data_lo;
+static bool dev_clock_lo, dev_data_lo;
+static bool clock_last = true;
+
+static bool clock_line(void) { return !(host_clock_lo || dev_clock_lo); }
+static bool data_line(void) { return !(host_data_lo || dev_data_lo); }
+
+static void irq_dispatch(void);
+static void clock_fall(void);
+
+/* called when host or device changes line */
+static void line_change(void)
+{
+    bool clock = clock_line();
+    if (clock_last && !clock) clock_fall();
+    clock_last = clock;
+    irq_dispatch();
+}
+
+void clock_init(void) {}
+void clock_lo(void) { host_clock_lo = true; line_change(); }
+void clock_hi(void) { host_clock_lo = false; line_change(); }
+bool clock_in(void) { return clock_line(); }
+void data_init(void) {}
+void data_lo(void) { host_data_lo = true; line_change(); }
+void data_hi(void) { host_data_lo = false; line_change(); }
+bool data_in(void) { return data_line(); }
+
+
+/*
+ * Pin interrupt
+ */
+#ifdef PS2_USE_INT
+static bool int_enabled, int_flag;
+#define PS2_INT_INIT()
+#define PS2_INT_ON()    do { int_enabled = true; irq_dispatch(); } while (0)
+#define PS2_INT_OFF()   (int_enabled = false)
+#define PS2_INT_VECT    sim_int_vect
+void PS2_INT_VECT(void);
+#endif
+
+
+/*
+ * USART receiver: start bit, 8 data bits, odd parity and stop bit
+ */
+#ifdef PS2_USE_USART
+static struct {
+    bool rxen;
+    bool rxcie;
+    bool rxc;           // byte in udr is unread
+    uint8_t ucsra;      // error flags of byte in udr
+    uint8_t udr;
+    uint8_t bit;        // bits shifted in frame, 0 while waiting for start bit
+    uint16_t shift;
+} usart;
+
+#define PS2_USART_ERROR_FRAME   (1<<4)
+#define PS2_USART_ERROR_OVERRUN (1<<3)
+#define PS2_USART_ERROR_PARITY  (1<<2)
+#define PS2_USART_INIT()        (usart.bit = 0, usart.shift = 0, usart.ucsra = 0)
+#define PS2_USART_RX_INT_ON()   do { usart.rxen = usart.rxcie = true; irq_dispatch(); } while (0)
+#define PS2_USART_OFF()         (usart.rxen = usart.rxcie = usart.rxc = false, usart.bit = 0, usart.shift = 0)
+#define PS2_USART_RX_DATA       usart_read()
+#define PS2_USART_ERROR         (usart.ucsra & (PS2_USART_ERROR_FRAME | PS2_USART_ERROR_OVERRUN | PS2_USART_ERROR_PARITY))
+#define PS2_USART_RX_VECT       sim_usart_rx_vect
+void PS2_USART_RX_VECT(void);
+
+static uint8_t usart_read(void)
+{
+    usart.rxc = false;
+    usart.ucsra = 0;
+    return usart.udr;
+}
+
+static void usart_clock(bool bit)
+{
+    if (usart.bit == 0 && bit) return;
+    usart.shift |= (uint16_t)bit << usart.bit;
+    if (++usart.bit < 11) return;
+
+    uint8_t data = usart.shift >> 1;
+    uint8_t error = 0;
+    if (__builtin_parity(data) == ((usart.shift >> 9) & 1)) error |= PS2_USART_ERROR_PARITY;
+    if (!(usart.shift & 0x400)) error |= PS2_USART_ERROR_FRAME;
+    if (usart.rxc) {
+        usart.ucsra |= PS2_USART_ERROR_OVERRUN;
+    } else {
+        usart.udr = data;
+        usart.ucsra = error;
+        usart.rxc = true;
+    }
+    usart.bit = 0;
+    usart.shift = 0;
+}
+#endif
+
+
+static void clock_fall(void)
+{
+#ifdef PS2_USE_INT
+    int_flag = true;
+#endif
+#ifdef PS2_USE_USART
+    if (usart.rxen) usart_clock(data_line());
+#endif
+}
+
+static void irq_dispatch(void)
+{
+    static bool in_isr = false;
+    if (in_isr || !(SREG & 0x80)) return;
+    in_isr = true;
+    SREG &= ~0x80;
+#ifdef PS2_USE_INT
+    if (int_enabled && int_flag) {
+        int_flag = false;
+        PS2_INT_VECT();
+    }
+#endif
+#ifdef PS2_USE_USART
+    if (usart.rxcie && usart.rxc) PS2_USART_RX_VECT();
+#endif
+    SREG |= 0x80;
+    in_isr = false;
+}
+
+
+/*
+ * Keyboard model
+ *
+ * Sends queued bytes with clock period of 60-80us and 100-800us between
+ * bytes. When host pulls clock low before the last clock of frame it stops
+ * and sends the byte again later. Command is received when host pulls data
+ * low and releases clock, and is answered with ACK(FA), BAT(AA) to Reset,
+ * last byte to Resend(FE) and FE to one with parity error.
+ */
+#define FAULT_PARITY    1   // parity bit inverted
+#define FAULT_STOP      2   // stop bit low
+#define FAULT_STRETCH   4   // clock stays low for 400us at parity bit
+#define KEYQ_SIZE       4096
+
+enum { KBD_IDLE, KBD_SEND, KBD_RECV };
+enum { SETUP, LOW, HIGH, ACK, ACK_CLOCK, RELEASE };
+
+static struct {
+    uint8_t state;
+    uint8_t phase;
+    uint32_t at;            // time of next step
+    uint32_t quiet;         // lines are released since
+    uint32_t rts;           // host requests to send since, 0 if not
+    uint32_t hold;          // doesn't send until
+    uint16_t frame;         // frame bits from start bit
+    uint8_t bit;            // bit being sent or received
+    bool reply;             // byte being sent is from reply queue
+    uint8_t fault;
+
+    uint8_t reply_q[8];
+    uint8_t nreply;
+    uint8_t key_q[KEYQ_SIZE];
+    uint8_t key_fault[KEYQ_SIZE];
+    int key_head, key_tail;
+
+    uint8_t last;           // last byte sent wholly
+    bool led_next;
+    uint8_t leds;
+    uint8_t cmd;            // last command received
+    long sent, aborted;
+} kbd;
+
+static uint32_t jitter(uint32_t min, uint32_t max)
+{
+    return min + rand() % (max - min + 1);
+}
+
+static void kbd_reply(uint8_t data)
+{
+    if (kbd.nreply < sizeof(kbd.reply_q)) kbd.reply_q[kbd.nreply++] = data;
+}
+
+static void kbd_key(uint8_t data, uint8_t fault)
+{
+    kbd.key_q[kbd.key_head] = data;
+    kbd.key_fault[kbd.key_head] = fault;
+    kbd.key_head = (kbd.key_head + 1) % KEYQ_SIZE;
+}
+
+static bool kbd_busy(void)
+{
+    return kbd.nreply || kbd.key_head != kbd.key_tail || kbd.state != KBD_IDLE;
+}
+
+static void kbd_set(bool *line, bool lo)
+{
+    *line = lo;
+    line_change();
+}
+
+static void kbd_idle(uint32_t hold)
+{
+    kbd.state = KBD_IDLE;
+    kbd.quiet = sim_us;
+    kbd.rts = 0;
+    kbd.hold = sim_us + hold;
+    dev_clock_lo = dev_data_lo = false;
+    line_change();
+}
+
+static void kbd_send_start(void)
+{
+    uint8_t data;
+    kbd.reply = (kbd.nreply != 0);
+    if (kbd.reply) {
+        data = kbd.reply_q[0];
+        kbd.fault = 0;
+    } else {
+        data = kbd.key_q[kbd.key_tail];
+        kbd.fault = kbd.key_fault[kbd.key_tail];
+        kbd.key_fault[kbd.key_tail] = 0;    // glitch doesn't repeat
+    }
+    bool parity = !__builtin_parity(data);
+    if (kbd.fault & FAULT_PARITY) parity = !parity;
+    bool stop = !(kbd.fault & FAULT_STOP);
+    kbd.frame = (uint16_t)data << 1 | (uint16_t)parity << 9 | (uint16_t)stop << 10;
+    kbd.state = KBD_SEND;
+    kbd.bit = 0;
+    kbd.phase = SETUP;
+    kbd.at = sim_us + jitter(15, 20);
+    kbd_set(&dev_data_lo, true);
+}
+
+static void kbd_send_done(void)
+{
+    uint8_t data = kbd.frame >> 1;
+    if (kbd.reply) {
+        memmove(kbd.reply_q, kbd.reply_q + 1, --kbd.nreply);
+    } else {
+        kbd.key_tail = (kbd.key_tail + 1) % KEYQ_SIZE;
+    }
+    kbd.last = data;
+    kbd.sent++;
+    kbd_idle(jitter(100, 800));
+}
+
+static void kbd_command(uint16_t frame)
+{
+    uint8_t data = frame;
+    if (__builtin_parity(data) == ((frame >> 8) & 1) || !(frame & 0x200)) {
+        kbd_reply(0xFE);
+        return;
+    }
+    kbd.cmd = data;
+    if (kbd.led_next) {
+        kbd.led_next = false;
+        kbd.leds = data;
+        kbd_reply(0xFA);
+        return;
+    }
+    switch (data) {
+        case 0xFE: kbd_reply(kbd.last); break;
+        case 0xED: kbd.led_next = true; kbd_reply(0xFA); break;
+        case 0xEE: kbd_reply(0xEE); break;
+        case 0xFF: kbd_reply(0xFA); kbd_reply(0xAA); break;
+        default:   kbd_reply(0xFA); break;
+    }
+}
+
+static void kbd_step(void)
+{
+    switch (kbd.state) {
+    case KBD_IDLE:
+        if (!clock_line()) {
+            kbd.quiet = sim_us;
+            kbd.rts = 0;
+        } else if (!data_line()) {
+            // Request to Send: start clocking in 50-500us
+            if (!kbd.rts) kbd.rts = sim_us + jitter(50, 500);
+            if (sim_us < kbd.rts) break;
+            kbd.state = KBD_RECV;
+            kbd.frame = 0;
+            kbd.bit = 0;
+            kbd.phase = LOW;
+            kbd.at = sim_us + jitter(35, 45);
+            kbd_set(&dev_clock_lo, true);
+        } else if ((kbd.nreply || kbd.key_head != kbd.key_tail) &&
+                   sim_us >= kbd.hold && sim_us - kbd.quiet >= 20) {
+            kbd_send_start();
+        }
+        break;
+    case KBD_SEND:
+        // inhibited before the last clock
+        if (!dev_clock_lo && !clock_line() && !(kbd.bit == 10 && kbd.phase == HIGH)) {
+            kbd.aborted++;
+            kbd_idle(0);
+            break;
+        }
+        if (sim_us < kbd.at) break;
+        switch (kbd.phase) {
+            case SETUP:
+                kbd.phase = LOW;
+                kbd.at = sim_us + (kbd.bit == 9 && (kbd.fault & FAULT_STRETCH) ? 400 : jitter(35, 45));
+                kbd_set(&dev_clock_lo, true);
+                break;
+            case LOW:
+                kbd.phase = HIGH;
+                kbd.at = sim_us + jitter(10, 15);
+                kbd_set(&dev_clock_lo, false);
+                break;
+            case HIGH:
+                if (++kbd.bit == 11) {
+                    kbd_send_done();
+                    break;
+                }
+                kbd.phase = SETUP;
+                kbd.at = sim_us + jitter(15, 20);
+                kbd_set(&dev_data_lo, !(kbd.frame & (1<<kbd.bit)));
+                break;
+        }
+        break;
+    case KBD_RECV:
+        if (!dev_clock_lo && !clock_line()) {
+            kbd_idle(0);
+            break;
+        }
+        if (sim_us < kbd.at) break;
+        switch (kbd.phase) {
+            case LOW:
+                // data bits, parity and stop bit are read at rising edge
+                kbd_set(&dev_clock_lo, false);
+                if (++kbd.bit <= 10) kbd.frame |= (uint16_t)data_line() << (kbd.bit - 1);
+                if (kbd.bit == 10) {
+                    kbd.phase = ACK;
+                    kbd.at = sim_us + jitter(5, 10);
+                } else if (kbd.bit == 11) {
+                    kbd.phase = RELEASE;
+                    kbd.at = sim_us + 5;
+                } else {
+                    kbd.phase = HIGH;
+                    kbd.at = sim_us + jitter(25, 35);
+                }
+                break;
+            case HIGH:
+            case ACK_CLOCK:
+                kbd.phase = LOW;
+                kbd.at = sim_us + jitter(35, 45);
+                kbd_set(&dev_clock_lo, true);
+                break;
+            case ACK:
+                kbd.phase = ACK_CLOCK;
+                kbd.at = sim_us + jitter(5, 10);
+                kbd_set(&dev_data_lo, true);
+                break;
+            case RELEASE:
+                kbd_command(kbd.frame);
+                kbd_idle(jitter(100, 1000));
+                break;
+        }
+        break;
+    }
+}
+
+static void sim_wait(uint32_t us)
+{
+    while (us--) {
+        sim_us++;
+        timer_count = sim_us / 4 / (TIMER_RAW_TOP + 1);
+        kbd_step();
+        irq_dispatch();
+    }
+}
+
+
+#if defined(PS2_USE_INT)
+#   include "../../protocol/ps2_interrupt.c"
+#elif defined(PS2_USE_USART)
+#   include "../../protocol/ps2_usart.c"
+#elif defined(PS2_USE_BUSYWAIT)
+#   include "../../protocol/ps2_busywait.c"
+#endif
+#include "../../protocol/ps2_kbd.c"
+
+
+/*
+ * Host loop: driver task and events as code | 0x100 when make
+ */
+#define EVENTS_MAX  (KEYQ_SIZE * 2)
+static uint16_t expect[EVENTS_MAX], got[EVENTS_MAX];
+static int nexpect, ngot;
+
+static void host_task(void)
+{
+    ps2_kbd_event_t event;
+    ps2_kbd_task();
+    while (ps2_kbd_event_peek(&event)) {
+        if (ngot < EVENTS_MAX) got[ngot++] = event.code | (event.make ? 0x100 : 0);
+        ps2_kbd_event_remove();
+    }
+}
+
+/* runs host loop until keyboard has sent everything, false if it takes over 10s */
+static bool host_run(void)
+{
+    uint32_t start = sim_us;
+    while (kbd_busy()) {
+        host_task();
+        sim_wait(100);
+        if (sim_us - start > 10000000) return false;
+    }
+    for (int i = 0; i < 50; i++) {
+        host_task();
+        sim_wait(100);
+    }
+    return true;
+}
+
+/* queues random key press or release of Set 2 and its event */
+static void type_key(uint8_t fault_rate)
+{
+    static const uint8_t e0_keys[] = { 0x11, 0x14, 0x1F, 0x27, 0x2F, 0x4A, 0x5A, 0x69, 0x6B, 0x6C,
+                                       0x70, 0x71, 0x72, 0x74, 0x75, 0x7A, 0x7D };
+    uint8_t bytes[3], n = 0;
+    bool make = rand() % 2;
+    bool e0 = rand() % 4 == 0;
+    uint8_t code = (e0 ? e0_keys[rand() % sizeof(e0_keys)] : 1 + rand() % 0x7F);
+    if (code == 0x7F) code = 0x83;  // F7
+    if (e0) bytes[n++] = 0xE0;
+    if (!make) bytes[n++] = 0xF0;
+    bytes[n++] = code;
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t fault = 0;
+        if (rand() % 100 < fault_rate) fault = 1 << rand() % 3;
+        kbd_key(bytes[i], fault);
+    }
+    expect[nexpect++] = (e0 ? code | 0x80 : code) | (make ? 0x100 : 0);
+}
+
+static void check_events(const char *name)
+{
+    int i = 0;
+    while (i < nexpect && i < ngot && got[i] == expect[i]) i++;
+    CHECK(ngot == nexpect && i == nexpect, "%s: %d events of %d, differ at %d: %03X expected %03X",
+          name, ngot, nexpect, i, i < ngot ? got[i] : 0, i < nexpect ? expect[i] : 0);
+    nexpect = ngot = 0;
+}
+
+static long errors(void)
+{
+    return ps2_error_count.parity + ps2_error_count.frame + ps2_error_count.timeout +
+           ps2_error_count.overflow + ps2_error_count.resend;
+}
+
+
+static void ps2_line_test(void)
+{
+    srand(1);
+    ps2_host_init();
+    host_run();
+
+    /* typing without error: throughput of keyboard clock and driver */
+    uint32_t start = sim_us;
+    long sent = kbd.sent;
+    for (int i = 0; i < 2000; i++) type_key(0);
+    CHECK(host_run(), "typing: keyboard not done");
+    double sec = (sim_us - start) / 1e6;
+    printf("typing: %ld bytes in %.3fs, %.0f bytes/s\n", kbd.sent - sent, sec, (kbd.sent - sent) / sec);
+    check_events("typing");
+    CHECK(errors() == 0, "typing: %ld errors", errors());
+
+    /* LED command round trip */
+    for (uint8_t led = 0; led < 8; led++) {
+        uint8_t ack = ps2_host_send(PS2_SET_LED);
+        CHECK(ack == PS2_ACK && !ps2_error, "ED: %02X error %02X", ack, ps2_error);
+        ack = ps2_host_send(led);
+        CHECK(ack == PS2_ACK && !ps2_error, "LED %u: %02X error %02X", led, ack, ps2_error);
+        CHECK(kbd.leds == led, "LED %u: keyboard has %u", led, kbd.leds);
+    }
+
+    /* every command byte without response of its own goes through */
+    for (int data = 0; data < 0x100; data++) {
+        if (data == 0xED || data == 0xEE || data == 0xFE || data == 0xFF) continue;
+        uint8_t ack = ps2_host_send(data);
+        CHECK(ack == PS2_ACK && kbd.cmd == data, "command %02X: keyboard got %02X, response %02X error %02X",
+              data, kbd.cmd, ack, ps2_error);
+    }
+    uint8_t echo = ps2_host_send(0xEE);
+    CHECK(echo == 0xEE, "echo: %02X", echo);
+    CHECK(errors() == 0, "commands: %ld errors", errors());
+
+    /* LED changes while typing: keyboard is inhibited in middle of frame */
+    long aborted = kbd.aborted;
+    for (int i = 0; i < 500; i++) type_key(0);
+    while (kbd_busy()) {
+        uint8_t led = rand() % 8;
+        ps2_host_set_led(led);
+        CHECK(kbd.leds == led && !ps2_error, "LED %u while typing: keyboard has %u error %02X",
+              led, kbd.leds, ps2_error);
+        for (uint32_t t = jitter(10, 40); t; t--) {
+            host_task();
+            sim_wait(100);
+        }
+    }
+    host_run();
+    check_events("LED while typing");
+    printf("LED while typing: %ld frames aborted by inhibit\n", kbd.aborted - aborted);
+    CHECK(kbd.aborted > aborted, "LED while typing: no frame aborted");
+
+    /* parity, stop bit and clock errors are recovered with resend */
+    ps2_error_count = (ps2_error_count_t){};
+    for (int i = 0; i < 2000; i++) type_key(5);
+    CHECK(host_run(), "errors: keyboard not done");
+    check_events("errors");
+    printf("errors: parity %u frame %u timeout %u overflow %u resend %u\n",
+           ps2_error_count.parity, ps2_error_count.frame, ps2_error_count.timeout,
+           ps2_error_count.overflow, ps2_error_count.resend);
+    CHECK(ps2_error_count.parity && ps2_error_count.frame && ps2_error_count.resend,
+          "errors: not counted");
+}
@@ -0,0 +1,28 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * PS/2 busywait driver ps2_busywait.c on simulated lines(ps2_line.h)
+ */
+#define PS2_USE_BUSYWAIT
+#include "ps2_line.h"
+
+int main(void)
+{
+    ps2_line_test();
+    return TEST_RESULT();
+}
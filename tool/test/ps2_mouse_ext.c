@@ -0,0 +1,301 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * IntelliMouse and Explorer extensions of ps2_mouse.c with simulated mice
+ *
+ * Simulated mouse answers commands of ps2_mouse_init() as standard mouse,
+ * IntelliMouse(ID 3), Explorer(ID 4) or Explorer 4.0 with horizontal wheel,
+ * and enables extension when it sees its sample rate sequence. Then it
+ * encodes random moves, wheel and buttons into packets of its format which
+ * are fed to stream mode decoder, and USB reports must give them back.
+ */
+#define WAIT_H
+#define wait_us(us)
+#define wait_ms(ms)
+#define PS2_USE_INT
+#define PS2_MOUSE_ENABLE
+#define PS2_MOUSE_SCROLL_BTN_MASK   0
+#include "../../protocol/ps2_mouse.c"
+
+debug_config_t debug_config;
+uint8_t ps2_error = PS2_ERR_NONE;
+ps2_error_count_t ps2_error_count;
+uint16_t timer_read(void) { return 0; }
+uint8_t host_mouse_wheel_multiplier_v(void) { return 1; }
+uint8_t host_mouse_wheel_multiplier_h(void) { return 1; }
+bool ps2_host_recv_failed(void) { return false; }
+void ps2_host_init(void) {}
+
+
+/*
+ * Simulated mouse
+ */
+enum { STANDARD, INTELLIMOUSE, EXPLORER, EXPLORER_4 };
+static const char *model_name[] = { "standard", "IntelliMouse", "Explorer", "Explorer 4.0" };
+
+static struct {
+    int model;
+    uint8_t id;
+    bool wheel6;            // 6-bit vertical or horizontal wheel
+    uint8_t rates[3];       // last sample rates set
+    bool rate_next;
+    bool reporting;
+    uint8_t resp[4];
+    uint8_t nresp;
+} mouse;
+
+static bool rates_are(uint8_t r1, uint8_t r2, uint8_t r3)
+{
+    return mouse.rates[0] == r1 && mouse.rates[1] == r2 && mouse.rates[2] == r3;
+}
+
+uint8_t ps2_host_send(uint8_t data)
+{
+    ps2_error = PS2_ERR_NONE;
+    mouse.nresp = 0;
+    if (mouse.rate_next) {
+        mouse.rate_next = false;
+        mouse.rates[0] = mouse.rates[1];
+        mouse.rates[1] = mouse.rates[2];
+        mouse.rates[2] = data;
+        if (mouse.model == EXPLORER_4 && mouse.id == PS2_MOUSE_ID_EXPLORER && rates_are(200, 80, 40))
+            mouse.wheel6 = true;
+        return PS2_ACK;
+    }
+    switch (data) {
+        case PS2_MOUSE_RESET:
+            mouse.id = PS2_MOUSE_ID_STANDARD;
+            mouse.wheel6 = false;
+            mouse.reporting = false;
+            mouse.resp[0] = 0xAA;
+            mouse.resp[1] = mouse.id;
+            mouse.nresp = 2;
+            break;
+        case PS2_MOUSE_SET_SAMPLE_RATE:
+            mouse.rate_next = true;
+            break;
+        case PS2_MOUSE_GET_DEVICE_ID:
+            if (mouse.model >= INTELLIMOUSE && rates_are(200, 100, 80))
+                mouse.id = PS2_MOUSE_ID_INTELLIMOUSE;
+            if (mouse.model >= EXPLORER && mouse.id == PS2_MOUSE_ID_INTELLIMOUSE && rates_are(200, 200, 80))
+                mouse.id = PS2_MOUSE_ID_EXPLORER;
+            mouse.resp[0] = mouse.id;
+            mouse.nresp = 1;
+            break;
+        case PS2_MOUSE_ENABLE_DATA_REPORTING:
+            mouse.reporting = true;
+            break;
+    }
+    return PS2_ACK;
+}
+
+uint8_t ps2_host_recv_response(void)
+{
+    if (!mouse.nresp) {
+        ps2_error = PS2_ERR_NODATA;
+        return 0;
+    }
+    uint8_t data = mouse.resp[0];
+    memmove(mouse.resp, mouse.resp + 1, --mouse.nresp);
+    return data;
+}
+
+/* move in USB direction: y down, v away from user and h right */
+typedef struct {
+    uint8_t buttons;
+    int16_t x, y, v, h;
+    bool x_ovf, y_ovf;
+} move_t;
+
+/* sends packet of move to decoder */
+static void mouse_packet(move_t *m)
+{
+    int16_t y = -m->y;  // PS/2 y is up
+    uint8_t packet[4] = {
+        (m->buttons & 0x07) | (1<<PS2_MOUSE_SYNC) |
+        (m->x < 0 ? 1<<PS2_MOUSE_X_SIGN : 0) | (y < 0 ? 1<<PS2_MOUSE_Y_SIGN : 0) |
+        (m->x_ovf ? 1<<PS2_MOUSE_X_OVFLW : 0) | (m->y_ovf ? 1<<PS2_MOUSE_Y_OVFLW : 0),
+        m->x & 0xFF,
+        y & 0xFF,
+        0
+    };
+    // PS/2 wheel is positive toward user
+    if (mouse.id == PS2_MOUSE_ID_INTELLIMOUSE) {
+        packet[3] = -m->v;
+    } else if (mouse.id == PS2_MOUSE_ID_EXPLORER) {
+        if (mouse.wheel6 && m->v) {
+            packet[3] = (1<<PS2_MOUSE_WHEEL_V) | (-m->v & 0x3F);
+        } else if (mouse.wheel6 && m->h) {
+            packet[3] = (1<<PS2_MOUSE_WHEEL_H) | (-m->h & 0x3F);
+        } else {
+            packet[3] = (-m->v & 0x0F) |
+                        ((m->buttons & MOUSE_BTN4) ? 1<<PS2_MOUSE_BTN_4 : 0) |
+                        ((m->buttons & MOUSE_BTN5) ? 1<<PS2_MOUSE_BTN_5 : 0);
+        }
+    }
+    for (uint8_t i = 0; i < packet_size; i++) ps2_mouse_recv(packet[i]);
+}
+
+
+/*
+ * USB reports
+ */
+static report_mouse_t reports[16];
+static int nreports;
+
+void host_mouse_send(report_mouse_t *report)
+{
+    if (nreports < 16) reports[nreports++] = *report;
+}
+
+static int16_t clamp(int16_t d, int16_t max)
+{
+    return (d > max ? max : (d < -max ? -max : d));
+}
+
+/* one packet makes one report unless nothing changes */
+static void check_move(move_t *m, uint8_t buttons_prev, const char *name)
+{
+    nreports = 0;
+    mouse_packet(m);
+    ps2_mouse_task();
+
+    int16_t x = (m->x_ovf ? (m->x < 0 ? -256 : 255) : m->x);
+    int16_t y = (m->y_ovf ? (m->y > 0 ? 256 : -255) : m->y);
+    if (!x && !y && !m->v && !m->h && m->buttons == buttons_prev) {
+        CHECK(nreports == 0, "%s: %d reports without change", name, nreports);
+        return;
+    }
+    CHECK(nreports == 1, "%s: %d reports", name, nreports);
+    if (nreports != 1) return;
+    report_mouse_t *r = &reports[0];
+    bool same = (r->buttons == m->buttons && r->x == clamp(x, MOUSE_XY_MAX) &&
+                 r->y == clamp(y, MOUSE_XY_MAX) && r->v == clamp(m->v, 127) && r->h == clamp(m->h, 127));
+    CHECK(same, "%s: report %02X %d %d %d %d, move %02X %d %d %d %d", name,
+          r->buttons, r->x, r->y, r->v, r->h, m->buttons, m->x, m->y, m->v, m->h);
+}
+
+/* packet without move and 4th byte 'z' makes report of buttons and wheel */
+static void check_raw(uint8_t z, uint8_t buttons, int8_t v, int8_t h, const char *name)
+{
+    nreports = 0;
+    ps2_mouse_recv(1<<PS2_MOUSE_SYNC);
+    ps2_mouse_recv(0);
+    ps2_mouse_recv(0);
+    ps2_mouse_recv(z);
+    ps2_mouse_task();
+    CHECK(nreports == 1 && reports[0].buttons == buttons && reports[0].v == v && reports[0].h == h,
+          "%s: %d reports, %02X v %d h %d", name, nreports, reports[0].buttons, reports[0].v, reports[0].h);
+}
+
+static void init(int model, uint8_t id, uint8_t size, bool wheel6)
+{
+    memset(&mouse, 0, sizeof(mouse));
+    mouse.model = model;
+    device_id = PS2_MOUSE_ID_STANDARD;
+    packet_size = 3;
+    buttons_ext = 0;
+    ps2_mouse_init();
+    CHECK(device_id == id && packet_size == size, "%s: ID %u packet %u bytes",
+          model_name[model], device_id, packet_size);
+    CHECK(mouse.wheel6 == wheel6, "%s: 6-bit wheel %s", model_name[model], mouse.wheel6 ? "on" : "off");
+    CHECK(mouse.reporting && mouse.rates[2] == PS2_MOUSE_SAMPLE_RATE, "%s: reporting %d at rate %u",
+          model_name[model], mouse.reporting, mouse.rates[2]);
+}
+
+static int16_t random_range(int16_t min, int16_t max)
+{
+    return min + rand() % (max - min + 1);
+}
+
+int main(void)
+{
+    static const struct { uint8_t id, size; bool wheel6; } expect[] = {
+        [STANDARD]      = { PS2_MOUSE_ID_STANDARD, 3, false },
+        [INTELLIMOUSE]  = { PS2_MOUSE_ID_INTELLIMOUSE, 4, false },
+        [EXPLORER]      = { PS2_MOUSE_ID_EXPLORER, 4, false },
+        [EXPLORER_4]    = { PS2_MOUSE_ID_EXPLORER, 4, true },
+    };
+
+    /* 4th byte of packets */
+    init(INTELLIMOUSE, PS2_MOUSE_ID_INTELLIMOUSE, 4, false);
+    check_raw(0x01, 0, -1, 0, "ID 3 wheel 01");
+    check_raw(0xFF, 0, 1, 0, "ID 3 wheel FF");
+    check_raw(0x81, 0, 127, 0, "ID 3 wheel 81");
+    init(EXPLORER_4, PS2_MOUSE_ID_EXPLORER, 4, true);
+    check_raw(0x0F, 0, 1, 0, "ID 4 wheel 0F");
+    check_raw(0x08, 0, 8, 0, "ID 4 wheel 08");
+    check_raw(0x10, MOUSE_BTN4, 0, 0, "ID 4 Btn4");
+    check_raw(0x41, MOUSE_BTN4, 0, -1, "ID 4 Btn4 held, horizontal 41");
+    check_raw(0xBF, MOUSE_BTN4, 1, 0, "ID 4 Btn4 held, vertical BF");
+    check_raw(0x60, MOUSE_BTN4, 0, 32, "ID 4 Btn4 held, horizontal 60");
+    check_raw(0x2F, MOUSE_BTN5, 1, 0, "ID 4 Btn5, wheel 2F");
+    check_raw(0x00, 0, 0, 0, "ID 4 release");
+
+    srand(1);
+    for (int model = STANDARD; model <= EXPLORER_4; model++) {
+        init(model, expect[model].id, expect[model].size, expect[model].wheel6);
+        uint8_t buttons = 0;
+        for (int i = 0; i < 10000; i++) {
+            move_t m = { .buttons = rand() % 8 };
+            m.x = random_range(-256, 255);
+            m.y = random_range(-255, 256);
+            m.x_ovf = (rand() % 16 == 0);
+            m.y_ovf = (rand() % 16 == 0);
+            if (model == INTELLIMOUSE) {
+                m.v = random_range(-127, 127);
+            } else if (model == EXPLORER) {
+                m.buttons |= (rand() % 4) << 3;
+                m.v = random_range(-7, 8);
+            } else if (model == EXPLORER_4) {
+                m.buttons |= (rand() % 4) << 3;
+                // buttons 4 and 5 are in packet without wheel only
+                if (!((m.buttons ^ buttons) & (MOUSE_BTN4 | MOUSE_BTN5))) {
+                    if (rand() % 2)
+                        m.v = random_range(-31, 32);
+                    else
+                        m.h = random_range(-31, 32);
+                }
+            }
+            check_move(&m, buttons, model_name[model]);
+            buttons = m.buttons;
+            if (test_failed) break;
+        }
+    }
+
+    /* packets of same buttons are merged, button change is sent alone */
+    init(INTELLIMOUSE, PS2_MOUSE_ID_INTELLIMOUSE, 4, false);
+    nreports = 0;
+    mouse_packet(&(move_t){ .x = 10, .y = 5, .v = 1 });
+    mouse_packet(&(move_t){ .x = 20, .y = -5, .v = 1 });
+    mouse_packet(&(move_t){ .buttons = MOUSE_BTN1, .x = 1 });
+    ps2_mouse_task();
+    CHECK(nreports == 2 && reports[0].x == 30 && reports[0].y == 0 && reports[0].v == 2 && !reports[0].buttons &&
+          reports[1].buttons == MOUSE_BTN1 && reports[1].x == 1, "merge: %d reports", nreports);
+
+    /* report is sent before merged X or Y exceeds it */
+    nreports = 0;
+    mouse_packet(&(move_t){ .x = 100, .y = -100 });
+    mouse_packet(&(move_t){ .x = 20, .y = -20 });
+    mouse_packet(&(move_t){ .x = 100, .y = 10 });
+    ps2_mouse_task();
+    CHECK(nreports == 2 && reports[0].x == 120 && reports[0].y == -120 &&
+          reports[1].x == 100 && reports[1].y == 10, "merge over 127: %d reports", nreports);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,202 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Scan Code Set 2 table decoder of ps2_kbd.c against switch decoder
+ *
+ * Checks PrintScreen, Pause, fake shift and other sequences on their own,
+ * then feeds random byte streams to the table decoder and to the switch
+ * decoder it replaced and compares events. The one intended difference is
+ * 00 after E0 or E0 F0: switch decoder gave key 80, table decoder clears
+ * keys as for 00 anywhere else.
+ */
+#define WAIT_H
+#define wait_us(us)
+#define wait_ms(ms)
+#define PS2_KBD_ENABLE
+#include "../../protocol/ps2_kbd.c"
+
+uint16_t timer_read(void) { return 0; }
+uint8_t ps2_error = PS2_ERR_NONE;
+ps2_error_count_t ps2_error_count;
+uint8_t ps2_host_send(uint8_t data) { (void)data; return 0; }
+bool ps2_host_recv_failed(void) { return false; }
+
+
+/* events as code | 0x100 when make */
+#define EVENTS_MAX  64
+typedef struct {
+    uint16_t ev[EVENTS_MAX];
+    int n;
+} events_t;
+
+static void events_add(events_t *e, uint8_t code, bool make)
+{
+    if (e->n < EVENTS_MAX) e->ev[e->n++] = code | (make ? 0x100 : 0);
+}
+
+/* feeds byte to table decoder and takes events out */
+static void table_recv(uint8_t code, events_t *e)
+{
+    ps2_kbd_event_t event;
+    ps2_kbd_recv(code);
+    while (ps2_kbd_event_peek(&event)) {
+        events_add(e, event.code, event.make);
+        ps2_kbd_event_remove();
+    }
+}
+
+
+/*
+ * Switch decoder before table
+ */
+static events_t *old_events;
+static void old_put(uint8_t code, bool make) { events_add(old_events, code, make); }
+static void unexpected(uint8_t code) { (void)code; old_put(PS2_KBD_CLEAR, false); }
+
+static void old_recv(uint8_t code, events_t *e)
+{
+    static enum {
+        INIT, F0, E0, E0_F0,
+        E1, E1_14, E1_14_77, E1_14_77_E1, E1_14_77_E1_F0, E1_14_77_E1_F0_14, E1_14_77_E1_F0_14_F0,
+        E0_7E, E0_7E_E0, E0_7E_E0_F0,
+    } state = INIT;
+
+    old_events = e;
+    switch (state) {
+        case INIT:
+            switch (code) {
+                case 0xE0: state = E0; break;
+                case 0xF0: state = F0; break;
+                case 0xE1: state = E1; break;
+                case 0x83: old_put(PS2_KBD_F7, true); break;
+                case 0x84: old_put(PS2_KBD_PRINT_SCREEN, true); break;
+                case 0x00: old_put(PS2_KBD_CLEAR, false); break;
+                default:
+                    if (code < 0x80) old_put(code, true); else unexpected(code);
+            }
+            break;
+        case E0:
+            switch (code) {
+                case 0x12:
+                case 0x59: state = INIT; break;
+                case 0x7E: state = E0_7E; break;
+                case 0xF0: state = E0_F0; break;
+                default:
+                    if (code < 0x80) old_put(code|0x80, true); else unexpected(code);
+                    state = INIT;
+            }
+            break;
+        case F0:
+            switch (code) {
+                case 0x83: old_put(PS2_KBD_F7, false); state = INIT; break;
+                case 0x84: old_put(PS2_KBD_PRINT_SCREEN, false); state = INIT; break;
+                case 0xF0: unexpected(code); break;
+                default:
+                    if (code < 0x80) old_put(code, false); else unexpected(code);
+                    state = INIT;
+            }
+            break;
+        case E0_F0:
+            switch (code) {
+                case 0x12:
+                case 0x59: state = INIT; break;
+                default:
+                    if (code < 0x80) old_put(code|0x80, false); else unexpected(code);
+                    state = INIT;
+            }
+            break;
+        case E1:                    state = (code == 0x14 ? E1_14 : INIT); break;
+        case E1_14:                 state = (code == 0x77 ? E1_14_77 : INIT); break;
+        case E1_14_77:              state = (code == 0xE1 ? E1_14_77_E1 : INIT); break;
+        case E1_14_77_E1:           state = (code == 0xF0 ? E1_14_77_E1_F0 : INIT); break;
+        case E1_14_77_E1_F0:        state = (code == 0x14 ? E1_14_77_E1_F0_14 : INIT); break;
+        case E1_14_77_E1_F0_14:     state = (code == 0xF0 ? E1_14_77_E1_F0_14_F0 : INIT); break;
+        case E1_14_77_E1_F0_14_F0:
+            if (code == 0x77) old_put(PS2_KBD_PAUSE, true);
+            state = INIT;
+            break;
+        case E0_7E:                 state = (code == 0xE0 ? E0_7E_E0 : INIT); break;
+        case E0_7E_E0:              state = (code == 0xF0 ? E0_7E_E0_F0 : INIT); break;
+        case E0_7E_E0_F0:
+            if (code == 0x7E) old_put(PS2_KBD_PAUSE, true);
+            state = INIT;
+            break;
+    }
+
+    /* intended change: 00 after E0 clears keys */
+    if (e->n && e->ev[e->n - 1] == 0x80) e->ev[e->n - 1] = PS2_KBD_CLEAR;
+    if (e->n && e->ev[e->n - 1] == (0x80 | 0x100)) e->ev[e->n - 1] = PS2_KBD_CLEAR;
+}
+
+
+/* sequence and events expected, make as code | 0x100 */
+static void sequence(const char *name, const uint8_t *bytes, int n, const uint16_t *expect, int nexpect)
+{
+    events_t e = {};
+    for (int i = 0; i < n; i++) table_recv(bytes[i], &e);
+    bool same = (e.n == nexpect && memcmp(e.ev, expect, nexpect * sizeof(expect[0])) == 0);
+    CHECK(same, "%s: %d events, first %03X", name, e.n, e.n ? e.ev[0] : 0);
+}
+#define SEQ(name, bytes, ...)   do { \
+    const uint8_t b[] = { bytes }; \
+    const uint16_t x[] = { 0, ##__VA_ARGS__ }; \
+    sequence(name, b, sizeof(b), x + 1, sizeof(x) / sizeof(x[0]) - 1); \
+} while (0)
+#define B(...)      __VA_ARGS__
+#define MAKE(c)     ((c) | 0x100)
+#define BREAK(c)    (c)
+
+int main(void)
+{
+    SEQ("A", B(0x1C, 0xF0, 0x1C), MAKE(0x1C), BREAK(0x1C));
+    SEQ("Insert", B(0xE0, 0x70, 0xE0, 0xF0, 0x70), MAKE(0xF0), BREAK(0xF0));
+    SEQ("F7", B(0x83, 0xF0, 0x83), MAKE(PS2_KBD_F7), BREAK(PS2_KBD_F7));
+    SEQ("PrintScreen", B(0xE0, 0x12, 0xE0, 0x7C, 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12),
+        MAKE(PS2_KBD_PRINT_SCREEN), BREAK(PS2_KBD_PRINT_SCREEN));
+    SEQ("Alt'd PrintScreen", B(0x84, 0xF0, 0x84), MAKE(PS2_KBD_PRINT_SCREEN), BREAK(PS2_KBD_PRINT_SCREEN));
+    SEQ("Pause", B(0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77), MAKE(PS2_KBD_PAUSE));
+    SEQ("Control'd Pause", B(0xE0, 0x7E, 0xE0, 0xF0, 0x7E), MAKE(PS2_KBD_PAUSE));
+    SEQ("broken Pause", B(0xE1, 0x14, 0x1C), );
+    SEQ("fake shift", B(0xE0, 0xF0, 0x12, 0xE0, 0x70, 0xE0, 0xF0, 0x70, 0xE0, 0x12), MAKE(0xF0), BREAK(0xF0));
+    SEQ("fake shift 59", B(0xE0, 0xF0, 0x59, 0xE0, 0x71, 0xE0, 0xF0, 0x71, 0xE0, 0x59), MAKE(0xF1), BREAK(0xF1));
+    SEQ("overrun", B(0x00), BREAK(PS2_KBD_CLEAR));
+    SEQ("E0 overrun", B(0xE0, 0x00, 0x1C), BREAK(PS2_KBD_CLEAR), MAKE(0x1C));
+    SEQ("F0 F0", B(0xF0, 0xF0, 0x1C), BREAK(PS2_KBD_CLEAR), BREAK(0x1C));
+    SEQ("BAT", B(0xAA), BREAK(PS2_KBD_CLEAR));
+
+    srand(1);
+    static const uint8_t special[] = {
+        0x00, 0x12, 0x14, 0x59, 0x77, 0x7E, 0x7C, 0x83, 0x84, 0xAA, 0xE0, 0xE0, 0xE1, 0xF0, 0xF0, 0xF0
+    };
+    long bytes = 0, events = 0;
+    for (int n = 0; n < 20000; n++) {
+        events_t t = {}, o = {};
+        for (int i = 0; i < 16; i++) {
+            uint8_t code = (rand() % 2 ? special[rand() % sizeof(special)] : rand());
+            table_recv(code, &t);
+            old_recv(code, &o);
+            bytes++;
+        }
+        events += t.n;
+        bool same = (t.n == o.n && memcmp(t.ev, o.ev, t.n * sizeof(t.ev[0])) == 0);
+        CHECK(same, "stream %d: %d events vs %d", n, t.n, o.n);
+        if (!same) break;
+    }
+    printf("%ld random bytes, %ld events\n", bytes, events);
+    return TEST_RESULT();
+}
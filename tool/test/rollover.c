@@ -0,0 +1,203 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * 6KRO slot chain of action_util.c(USB_6KRO_ENABLE) against circular buffer
+ *
+ * Random press/release sequences are applied to the slot chain and to the
+ * circular buffer it replaced, then set of keys in report and get_first_key()
+ * are compared and chain of ro_next/ro_prev and free list ro_free checked.
+ */
+#define USB_6KRO_ENABLE
+#include "../../common/action_util.c"
+#include "../../common/util.c"
+
+void host_keyboard_send(report_keyboard_t *report) { (void)report; }
+uint16_t timer_read(void) { return 0; }
+
+
+/* circular buffer before slot chain */
+static report_keyboard_t cb_report;
+#define RO_ADD(a, b) ((a + b) % KEYBOARD_REPORT_KEYS)
+#define RO_SUB(a, b) ((a - b + KEYBOARD_REPORT_KEYS) % KEYBOARD_REPORT_KEYS)
+#define RO_INC(a) RO_ADD(a, 1)
+#define RO_DEC(a) RO_SUB(a, 1)
+static int8_t cb_head = 0;
+static int8_t cb_tail = 0;
+static int8_t cb_count = 0;
+
+static void cb_add(uint8_t code)
+{
+    int8_t i = cb_head;
+    int8_t empty = -1;
+    if (cb_count) {
+        do {
+            if (cb_report.keys[i] == code) {
+                return;
+            }
+            if (empty == -1 && cb_report.keys[i] == 0) {
+                empty = i;
+            }
+            i = RO_INC(i);
+        } while (i != cb_tail);
+        if (i == cb_tail) {
+            if (cb_tail == cb_head) {
+                if (empty == -1) {
+                    cb_head = RO_INC(cb_head);
+                    cb_count--;
+                }
+                else {
+                    uint8_t offset = 1;
+                    i = RO_INC(empty);
+                    do {
+                        if (cb_report.keys[i] != 0) {
+                            cb_report.keys[empty] = cb_report.keys[i];
+                            cb_report.keys[i] = 0;
+                            empty = RO_INC(empty);
+                        }
+                        else {
+                            offset++;
+                        }
+                        i = RO_INC(i);
+                    } while (i != cb_tail);
+                    cb_tail = RO_SUB(cb_tail, offset);
+                }
+            }
+        }
+    }
+    cb_report.keys[cb_tail] = code;
+    cb_tail = RO_INC(cb_tail);
+    cb_count++;
+}
+
+static void cb_del(uint8_t code)
+{
+    uint8_t i = cb_head;
+    if (cb_count) {
+        do {
+            if (cb_report.keys[i] == code) {
+                cb_report.keys[i] = 0;
+                cb_count--;
+                if (cb_count == 0) {
+                    cb_tail = cb_head = 0;
+                }
+                if (i == RO_DEC(cb_tail)) {
+                    do {
+                        cb_tail = RO_DEC(cb_tail);
+                        if (cb_report.keys[RO_DEC(cb_tail)] != 0) {
+                            break;
+                        }
+                    } while (cb_tail != cb_head);
+                }
+                break;
+            }
+            i = RO_INC(i);
+        } while (i != cb_tail);
+    }
+}
+
+static uint8_t cb_first(void)
+{
+    uint8_t i = cb_head;
+    do {
+        if (cb_report.keys[i] != 0) {
+            break;
+        }
+        i = RO_INC(i);
+    } while (i != cb_tail);
+    return cb_report.keys[i];
+}
+
+
+/* keys[] as bitmap to compare sets */
+static void key_set(uint8_t *keys, uint8_t set[32])
+{
+    for (int i = 0; i < 32; i++) set[i] = 0;
+    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (keys[i]) set[keys[i]>>3] |= 1<<(keys[i]&7);
+    }
+}
+
+/* chain from head to tail, free list and slots not used yet cover all slots once */
+static bool chain_ok(void)
+{
+    uint8_t seen = 0;
+    uint8_t prev = RO_NONE;
+    for (uint8_t s = ro_head; s != RO_NONE; s = ro_next[s]) {
+        if (s >= KEYBOARD_REPORT_KEYS || (seen & (1<<s)) || ro_prev[s] != prev) return false;
+        if (!keyboard_report->keys[s]) return false;
+        seen |= 1<<s;
+        prev = s;
+    }
+    if (prev != ro_tail) return false;
+    for (uint8_t s = ro_free; s != RO_NONE; s = ro_next[s]) {
+        if (s >= ro_unused || (seen & (1<<s)) || keyboard_report->keys[s]) return false;
+        seen |= 1<<s;
+    }
+    for (uint8_t s = ro_unused; s < KEYBOARD_REPORT_KEYS; s++) {
+        if ((seen & (1<<s)) || keyboard_report->keys[s]) return false;
+        seen |= 1<<s;
+    }
+    return seen == (1<<KEYBOARD_REPORT_KEYS) - 1;
+}
+
+#define SEQS    1000
+#define STEPS   1000
+
+int main(void)
+{
+    srand(1);
+    for (int n = 0; n < SEQS && !test_failed; n++) {
+        /* few distinct keys make repeated presses and full report common */
+        uint8_t range = 4 + n % 12;
+        clear_keys();
+        cb_report = (report_keyboard_t){};
+        cb_head = cb_tail = cb_count = 0;
+
+        for (int i = 0; i < STEPS; i++) {
+            uint8_t code = KC_A + rand() % range;
+            bool press = rand() % 3;
+            if (press) {
+                add_key(code);
+                cb_add(code);
+            } else {
+                del_key(code);
+                cb_del(code);
+            }
+
+            uint8_t set[32], cb_set[32];
+            key_set(keyboard_report->keys, set);
+            key_set(cb_report.keys, cb_set);
+            CHECK(memcmp(set, cb_set, 32) == 0, "seq %d step %d: key set differs", n, i);
+            CHECK(get_first_key() == cb_first(), "seq %d step %d: first %02X != %02X",
+                  n, i, get_first_key(), cb_first());
+            CHECK(chain_ok(), "seq %d step %d: broken chain", n, i);
+            if (test_failed) break;
+        }
+    }
+
+    /* newest keys win */
+    clear_keys();
+    for (uint8_t code = KC_A; code < KC_A + 8; code++) add_key(code);
+    CHECK(get_first_key() == KC_C, "oldest after 8 presses: %02X", get_first_key());
+    del_key(KC_C);
+    add_key(KC_Z);
+    CHECK(get_first_key() == KC_D, "oldest after release: %02X", get_first_key());
+    CHECK(has_anykey() == 6, "keys: %u", has_anykey());
+
+    return TEST_RESULT();
+}
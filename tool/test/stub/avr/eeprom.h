@@ -0,0 +1,10 @@
+/* EEPROM of ATmega32U4 simulated in memory, address is pointer as on AVR */
+#include <stdint.h>
+#include <string.h>
+#define E2END   0x3FF
+static uint8_t eeprom_sim[E2END + 1];
+#define eeprom_read_byte(p)             (eeprom_sim[(uintptr_t)(p)])
+#define eeprom_write_byte(p, v)         (eeprom_sim[(uintptr_t)(p)] = (v))
+#define eeprom_update_byte(p, v)        eeprom_write_byte(p, v)
+#define eeprom_read_block(dst, p, n)    memcpy((dst), &eeprom_sim[(uintptr_t)(p)], (n))
+#define eeprom_update_block(src, p, n)  memcpy(&eeprom_sim[(uintptr_t)(p)], (src), (n))
@@ -0,0 +1,9 @@
+/* status register and interrupt handler on host, handlers are run by test */
+#ifndef AVR_INTERRUPT_H
+#define AVR_INTERRUPT_H
+#include <stdint.h>
+static volatile uint8_t SREG = 0x80;
+#define cli()       (SREG &= ~0x80)
+#define sei()       (SREG |= 0x80)
+#define ISR(vect)   void vect(void)
+#endif
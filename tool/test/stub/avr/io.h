@@ -0,0 +1 @@
+/* no I/O registers on host */
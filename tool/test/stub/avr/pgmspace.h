@@ -0,0 +1,6 @@
+/* program memory is plain memory on host */
+#include <stdint.h>
+#define PROGMEM
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define pgm_read_word(p)    (*(const uint16_t *)(p))
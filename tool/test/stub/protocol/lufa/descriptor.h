@@ -0,0 +1,2 @@
+/* endpoint size of protocol/lufa/descriptor.h without LUFA */
+#define NKRO_EPSIZE                 16
@@ -0,0 +1,11 @@
+/* V-USB configuration used by protocol/vusb/vusb.c */
+#define USB_CFG_DESCR_PROPS_CONFIGURATION   1
+#define USB_CFG_HAVE_INTRIN_ENDPOINT        1
+#define USB_CFG_HAVE_INTRIN_ENDPOINT3       1
+#define USB_CFG_EP3_NUMBER                  3
+#define USB_CFG_INTERFACE_CLASS             3
+#define USB_CFG_INTERFACE_SUBCLASS          0
+#define USB_CFG_INTERFACE_PROTOCOL          0
+#define USB_CFG_INTR_POLL_INTERVAL          10
+#define USB_CFG_IS_SELF_POWERED             0
+#define USB_CFG_MAX_BUS_POWER               100
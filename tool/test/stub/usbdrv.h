@@ -0,0 +1,49 @@
+/*
+ * V-USB driver API used by protocol/vusb/vusb.c
+ *
+ * Interrupt endpoint functions are implemented by test to model host polls.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include "usbconfig.h"
+
+typedef unsigned char uchar;
+typedef uint8_t usbMsgLen_t;
+#define USB_PUBLIC
+#define USB_NO_MSG  ((usbMsgLen_t)0xFF)
+
+typedef union {
+    uint16_t word;
+    uchar    bytes[2];
+} usbWord_t;
+
+typedef struct usbRequest {
+    uchar       bmRequestType;
+    uchar       bRequest;
+    usbWord_t   wValue;
+    usbWord_t   wIndex;
+    usbWord_t   wLength;
+} usbRequest_t;
+
+#define USBRQ_TYPE_MASK         0x60
+#define USBRQ_TYPE_CLASS        (1<<5)
+#define USBRQ_HID_GET_REPORT    0x01
+#define USBRQ_HID_GET_IDLE      0x02
+#define USBRQ_HID_SET_REPORT    0x09
+#define USBRQ_HID_SET_IDLE      0x0a
+
+#define USBDESCR_CONFIG         2
+#define USBDESCR_INTERFACE      4
+#define USBDESCR_ENDPOINT       5
+#define USBDESCR_HID            0x21
+#define USBDESCR_HID_REPORT     0x22
+#define USBATTR_SELFPOWER       0x40
+
+extern const uchar *usbMsgPtr;
+
+void usbPoll(void);
+bool usbInterruptIsReady(void);
+void usbSetInterrupt(uchar *data, uchar len);
+bool usbInterruptIsReady3(void);
+void usbSetInterrupt3(uchar *data, uchar len);
@@ -0,0 +1,7 @@
+/* no busy wait on host unless test runs time in it */
+#ifndef _delay_ms
+#define _delay_ms(ms)
+#endif
+#ifndef _delay_us
+#define _delay_us(us)
+#endif
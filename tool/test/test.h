@@ -0,0 +1,53 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TEST_H
+#define TEST_H
+
+/*
+ * Host build of firmware modules for tests in tool/test
+ *
+ * Each test includes source file of the module to reach its static functions
+ * and state. This header is included before everything with -include and
+ * stub/ stands in for AVR and USB stack headers. Console output of firmware
+ * is compiled out.
+ */
+#define NO_PRINT
+#define NO_DEBUG
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* progmem.h has no host branch, program memory comes from stub */
+#include <avr/pgmspace.h>
+#define PROGMEM_H
+
+static int test_failed = 0;
+
+/* reports failure and carries on, test exits with 1 at the end */
+#define CHECK(cond, ...)    do { \
+    if (!(cond)) { \
+        printf("%s:%d: FAIL: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        test_failed++; \
+    } \
+} while (0)
+
+#define TEST_RESULT()   (printf("%s: %s\n", __FILE__, test_failed ? "FAILED" : "OK"), test_failed ? 1 : 0)
+
+#endif
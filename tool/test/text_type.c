@@ -0,0 +1,199 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Text typing of action_macro.c(action_macro_type)
+ *
+ * Text is typed through action_util.c into a host model which applies each
+ * report as host does, modifiers first, then releases, then presses in slot
+ * order(6KRO) or keycode order(NKRO), and maps presses to characters with
+ * its own US layout. Characters it gets must be the text for every printable
+ * ASCII character, whole printable range, random texts and with a key held.
+ */
+#define PROTOCOL_LUFA
+#define NKRO_ENABLE
+#include "../../common/action_macro.c"
+#include "../../common/action_util.c"
+#include "../../common/util.c"
+
+bool keyboard_nkro = false;
+uint16_t timer_read(void) { return 0; }
+uint16_t timer_elapsed(uint16_t last) { (void)last; return 0; }
+void register_code(uint8_t code) { add_key(code); send_keyboard_report(); }
+void unregister_code(uint8_t code) { del_key(code); send_keyboard_report(); }
+
+
+/*
+ * Host model
+ */
+/* US layout from KC_ENT to KC_SLSH */
+static const char us_plain[] = "\n\x1b\b\t -=[]\\\0;'`,./";
+static const char us_shift[] = "\n\x1b\b\t _+{}|\0:\"~<>?";
+
+static char us_char(uint8_t code, bool shift)
+{
+    if (code >= KC_A && code <= KC_Z)
+        return (shift ? 'A' : 'a') + code - KC_A;
+    if (code >= KC_1 && code <= KC_0)
+        return (shift ? "!@#$%^&*()" : "1234567890")[code - KC_1];
+    if (code >= KC_ENT && code <= KC_SLSH)
+        return (shift ? us_shift : us_plain)[code - KC_ENT];
+    return 0;
+}
+
+static bool held[256];
+static uint8_t host_mods;
+static char typed[4096];
+static int ntyped;
+static int reports;
+static int max_presses;
+
+void host_keyboard_send(report_keyboard_t *report)
+{
+    bool now[256] = {};
+    uint8_t order[256];
+    int n = 0;
+
+    if (keyboard_nkro) {
+        for (int code = 0; code < KEYBOARD_REPORT_BITS * 8; code++) {
+            if (report->nkro.bits[code>>3] & (1<<(code&7))) {
+                now[code] = true;
+                order[n++] = code;
+            }
+        }
+    } else {
+        for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            uint8_t code = report->keys[i];
+            if (code && !now[code]) {
+                now[code] = true;
+                order[n++] = code;
+            }
+        }
+    }
+
+    host_mods = report->mods;
+    for (int code = 0; code < 256; code++) {
+        if (held[code] && !now[code]) held[code] = false;
+    }
+    int presses = 0;
+    for (int i = 0; i < n; i++) {
+        uint8_t code = order[i];
+        if (held[code]) continue;
+        held[code] = true;
+        presses++;
+        char c = us_char(code, host_mods & (MOD_BIT(KC_LSHIFT) | MOD_BIT(KC_RSHIFT)));
+        if (c && ntyped < (int)sizeof(typed) - 1) typed[ntyped++] = c;
+    }
+    if (presses > max_presses) max_presses = presses;
+    reports++;
+}
+
+static void host_clear(void)
+{
+    memset(held, 0, sizeof(held));
+    host_mods = 0;
+    ntyped = 0;
+    reports = 0;
+    max_presses = 0;
+}
+
+
+/* types text and checks what host gets */
+static void type(const char *text, const char *name)
+{
+    ntyped = 0;
+    reports = 0;
+    max_presses = 0;
+    action_macro_type(text);
+    while (action_macro_playing()) action_macro_task();
+    typed[ntyped] = 0;
+
+    CHECK(strcmp(typed, text) == 0, "%s %s: typed \"%s\" expected \"%s\"",
+          keyboard_nkro ? "NKRO" : "6KRO", name, typed, text);
+    CHECK(max_presses <= 6, "%s: %d keys pressed in one report", name, max_presses);
+    CHECK(!(host_mods & MOD_BIT(KC_LSHIFT)), "%s: shift left on", name);
+}
+
+static void random_text(char *buf, int len, const char *chars)
+{
+    int n = strlen(chars);
+    for (int i = 0; i < len; i++) buf[i] = chars[rand() % n];
+    buf[len] = 0;
+}
+
+int main(void)
+{
+    char printable[0x7F - 0x20 + 1];
+    for (int c = 0x20; c < 0x7F; c++) printable[c - 0x20] = c;
+    printable[0x7F - 0x20] = 0;
+
+    for (int nkro = 0; nkro < 2; nkro++) {
+        keyboard_nkro = nkro;
+        clear_keys();
+        clear_weak_mods();
+        host_clear();
+
+        /* every printable character alone, pressed and released */
+        for (int c = 0x20; c < 0x7F; c++) {
+            char s[2] = { c, 0 };
+            type(s, "char");
+            /* press and release, and Shift off after shifted one */
+            int expect = (pgm_read_byte(&ascii_to_keycode[c]) & TEXT_SHIFT ? 3 : 2);
+            CHECK(reports == expect, "char %02X: %d reports", c, reports);
+            CHECK(!has_anykey(), "char %02X: key left on", c);
+        }
+        type(printable, "printable");
+        printf("%s: printable range in %d reports\n", nkro ? "NKRO" : "6KRO", reports);
+
+        /* control characters with key and characters without it */
+        type("a\tb\nc\x1b\b", "control");
+        ntyped = 0;
+        action_macro_type("x\x01y\x7F" "z");
+        while (action_macro_playing()) action_macro_task();
+        typed[ntyped] = 0;
+        CHECK(strcmp(typed, "xyz") == 0, "no key: typed \"%s\"", typed);
+
+        srand(1);
+        int total = 0, chars = 0;
+        for (int i = 0; i < 2000; i++) {
+            char buf[64];
+            random_text(buf, 1 + rand() % 63, (i & 1 ? printable : "aaabcdeeeefghiiijklmnoooprsssttuy  ,."));
+            type(buf, "random");
+            total += reports;
+            chars += strlen(buf);
+        }
+        printf("%s: random texts %d reports for %d characters\n", nkro ? "NKRO" : "6KRO", total, chars);
+
+        /* texts queued back to back */
+        ntyped = 0;
+        action_macro_type("abc");
+        action_macro_type("cab");
+        while (action_macro_playing()) action_macro_task();
+        typed[ntyped] = 0;
+        CHECK(strcmp(typed, "abccab") == 0, "queued: typed \"%s\"", typed);
+
+        /* key held: characters typed one per report, key stays on */
+        add_key(KC_F1);
+        send_keyboard_report();
+        type("Hello, World!", "held");
+        CHECK(reports >= 13, "held: %d reports", reports);
+        CHECK(held[KC_F1], "held: F1 released");
+        del_key(KC_F1);
+        send_keyboard_report();
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,104 @@
+/*
+Copyright 2015 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Decoder of trace log(TRACE_ENABLE) for Linux and other hosts
+ *
+ * Build:   cc -o trace_decode trace_decode.c
+ * Usage:   hid_listen | ./trace_decode
+ *
+ * Reads console output from stdin, formats trace records and passes other
+ * text through as it is.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include "../common/trace.h"
+
+
+static const struct {
+    const char *name;
+    const char *a;
+    const char *b;
+} events[] = {
+#define TRACE_NAME(id, name, a, b)  { name, a, b },
+    TRACE_EVENTS(TRACE_NAME)
+#undef TRACE_NAME
+};
+
+#define RECORD_DIGITS   12
+
+static int hex(const char *s, int n, unsigned *v)
+{
+    *v = 0;
+    for (int i = 0; i < n; i++) {
+        if (!isxdigit((unsigned char)s[i])) return 0;
+        *v = *v << 4 | (isdigit((unsigned char)s[i]) ? s[i] - '0' : (toupper(s[i]) - 'A' + 10));
+    }
+    return 1;
+}
+
+/* record is "~TTTTIIAABBBB" at end of line, text may come before it */
+static const char *find_record(const char *line)
+{
+    size_t len = strlen(line);
+    if (len < RECORD_DIGITS + 1) return NULL;
+
+    const char *p = line + len - RECORD_DIGITS - 1;
+    unsigned v;
+    if (*p != '~' || !hex(p + 1, RECORD_DIGITS, &v)) return NULL;
+    return p;
+}
+
+int main(void)
+{
+    char line[256];
+    unsigned last = 0;
+    int first = 1;
+    uint32_t time = 0;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        const char *p = find_record(line);
+        if (!p) {
+            puts(line);
+            continue;
+        }
+        if (p != line) printf("%.*s\n", (int)(p - line), line);
+
+        unsigned t, id, a, b;
+        hex(p + 1, 4, &t);
+        hex(p + 5, 2, &id);
+        hex(p + 7, 2, &a);
+        hex(p + 9, 4, &b);
+
+        /* 16bit timer of keyboard wraps around every 65.5s */
+        if (!first) time += (uint16_t)(t - last);
+        first = 0;
+        last = t;
+
+        printf("%8lu.%03lu ", (unsigned long)(time / 1000), (unsigned long)(time % 1000));
+        if (id < sizeof(events) / sizeof(events[0])) {
+            printf("%-16s %s=%02X %s=%04X\n", events[id].name, events[id].a, a, events[id].b, b);
+        } else {
+            printf("unknown(%02X)     a=%02X b=%04X\n", id, a, b);
+        }
+    }
+    return 0;
+}